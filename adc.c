@@ -0,0 +1,105 @@
+/*
+ * adc.c
+ *
+ * Created: 17.10.2026 12:41:37
+ */
+#include "hal.h"
+#include <stdint.h>
+#include "sound.h"
+#include "adc.h"
+
+static volatile uint8_t adc_ring[ADC_RING_SIZE];
+static volatile uint8_t adc_head;
+static volatile uint8_t adc_tail;
+static volatile uint8_t adc_active;
+static volatile uint8_t adc_avg;
+static uint8_t adc_skip, adc_count, adc_level, adc_run, adc_idle, adc_timed;
+static uint16_t adc_sum, adc_stamp;
+
+ISR(ADC_vect)
+{
+	uint8_t u = ADCH;
+	uint8_t level;
+
+	if(adc_skip){adc_skip--; return;}					//   
+	if(adc_count){										//  
+		adc_sum += u;
+		if(--adc_count == 0) adc_avg = adc_sum / ADC_AVG_SAMPLES;
+		return;
+	}
+	level = (u > adc_avg) ? ADC_HIGH : 0;
+	if(adc_run == 0){adc_level = level; adc_run = 1; adc_stamp = TCNT1; return;}
+	if(level == adc_level){
+		if(adc_run < ADC_LEN_MAX){adc_run++; return;}
+		adc_idle++;
+	}else adc_idle = 0;
+	if((uint8_t)(adc_head + 1) == adc_tail || adc_idle >= ADC_IDLE_RUNS){	//    ,
+		ADCSRA &= ~(1<<ADIE);							//Timer1  adc_wait(),   
+		adc_active = 0;
+		return;
+	}
+	if(adc_timed){										//  Timer1
+		uint16_t stamp = TCNT1;
+		uint16_t len = (uint16_t)(stamp - adc_stamp) >> 4;
+		adc_stamp = stamp;
+		adc_run = len > ADC_LEN_MAX ? ADC_LEN_MAX : (len ? len : 1);
+	}
+	adc_ring[adc_head] = adc_level | adc_run;
+	adc_head++;
+	adc_level = level;
+	adc_run = 1;
+}
+
+void adc_capture_start(uint8_t channel, uint8_t avg_u, uint8_t timed)
+{
+	adc_capture_stop();
+	ADMUX = (0 << REFS1)|(1 << REFS0) 					//   AVCC
+	|(1 << ADLAR)										//   (  1,  8   ADCH)
+	|(channel); 										//  channel
+	adc_head = 0;
+	adc_tail = 0;
+	adc_skip = 2;
+	adc_sum = 0;
+	adc_avg = avg_u;
+	adc_count = avg_u ? 0 : ADC_AVG_SAMPLES;
+	adc_level = 0;
+	adc_run = 0;
+	adc_idle = 0;
+	adc_timed = timed;
+	if(timed) timer1_claim();
+	adc_active = 1;
+	ADCSRA |= (1<<ADIF)|(1<<ADIE);
+}
+
+void adc_capture_stop(void)
+{
+	ADCSRA &= ~(1<<ADIE);
+	if(adc_timed) timer1_release();
+	adc_timed = 0;
+	adc_active = 0;
+}
+
+uint8_t adc_capture_avg(void)
+{
+	while(adc_count && adc_active) hal_idle();
+	return adc_avg;
+}
+
+uint8_t adc_wait(uint8_t pos)							//0 -   
+{
+	while(pos == adc_head){
+		if(adc_active == 0 && pos == adc_head){			//   - 
+			adc_capture_stop();
+			return 0;
+		}
+		hal_idle();
+	}
+	return adc_ring[pos];
+}
+
+uint8_t adc_next(void)									//   
+{
+	uint8_t entry = adc_wait(adc_tail);
+	if(entry) adc_tail++;
+	return entry;
+}
\ No newline at end of file
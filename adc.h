@@ -0,0 +1,33 @@
+/*
+ * adc.h
+ *
+ * Created: 17.10.2026 12:40:11
+ */
+#pragma once
+
+//ADC runs free at clk/16, one conversion takes 13 ADC clocks. The ISR has
+//no calls and needs about half of the 208 cycles in its longest path.
+#define ADC_CYCLES 208
+#define ADC_SAMPLES(us) ((uint16_t)((us) * (F_CPU / 1000000UL) / ADC_CYCLES))
+
+#define ADC_RING_SIZE 256								// uint8_t  
+#define ADC_AVG_SAMPLES 128								//   
+#define ADC_IDLE_RUNS 4									//     
+
+//   -     :
+//7  -  (1  ), 0-6  -   
+#define ADC_HIGH 0x80
+#define ADC_LEN(entry) ((entry) & 0x7F)
+#define ADC_LEN_MAX 0x7F
+
+//  ADC_TIMED    Timer1 ( 0,5 )   8 ,
+//       
+#define ADC_SAMPLED 0
+#define ADC_TIMED 1
+#define ADC_TIME(us) ((uint16_t)(us) / 8)
+
+void adc_capture_start(uint8_t channel, uint8_t avg_u, uint8_t timed);
+void adc_capture_stop(void);
+uint8_t adc_capture_avg(void);
+uint8_t adc_wait(uint8_t pos);
+uint8_t adc_next(void);
\ No newline at end of file
@@ -1,33 +1,103 @@
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
 #include <stdint.h>
+#include "sound.h"
 #include "dallas.h"
 
+#define DS_TICKS(us) ((uint16_t)((us) * (F_CPU / 8000000UL)))
+
+enum enum_ds_op{DS_OP_RESET, DS_OP_WRITE, DS_OP_READ, DS_OP_PROGRAM};
+enum enum_ds_state{DS_ST_IDLE, DS_ST_RESET, DS_ST_PRESENCE, DS_ST_RECOVERY, DS_ST_SLOT};
+enum enum_ds_job{DS_JOB_IDLE, DS_JOB_RESET, DS_JOB_COMMAND, DS_JOB_READ, DS_JOB_OD_RESET, DS_JOB_OD_COMMAND,
+				 DS_JOB_SEARCH_RESET, DS_JOB_SEARCH_COMMAND, DS_JOB_SEARCH_BITS, DS_JOB_SEARCH_DIR};
+
+static volatile uint8_t ds_state = DS_ST_IDLE;
+static volatile uint8_t ds_result;
+static volatile uint8_t ds_presence;
+static uint8_t ds_op, ds_bits, ds_bit, ds_shift;
+static uint8_t* ds_buf;
+static uint16_t ds_gap, ds_release;
+static uint16_t ds_program_gap = DS_TICKS(DS_GAP_SAFE);
+static uint16_t ds_profile[2] = {DS_GAP_SAFE, DS_GAP_SAFE};	//gap per bit in us, TM08 and RW1990
+static uint16_t ds_profile_floor[2] = {DS_GAP_MIN_TM08, DS_GAP_MIN_RW1990};	//raised above every gap that failed
+static uint8_t ds_profile_clean[2];						//verified writes at the current gap
+static uint8_t ds_profile_od[2] = {1, 1};				//blank type may answer at overdrive, cleared on first refusal
+static uint8_t ds_od;									//line runs at overdrive speed
+
+static uint8_t ds_job = DS_JOB_IDLE, ds_job_try, ds_job_time, ds_job_od;
+static uint8_t* ds_job_data;
+static uint8_t ds_job_rom[8], ds_job_copy[8];
+static uint8_t ds_cmd_read_rom = 0x33;
+static uint8_t ds_cmd_overdrive_skip = 0x3C;
+static uint8_t ds_cmd_search_rom = 0xF0;
+
+#define DS_SEARCH_DONE 0xFF
+static uint8_t ds_search_rom[8];						//last ROM found, the next pass follows it up to the fork
+static uint8_t ds_search_last = DS_SEARCH_DONE;			//fork taken with 0 last time, bits count from 1
+static uint8_t ds_search_zero, ds_search_bit, ds_search_pair, ds_search_dir;
+static uint8_t ds_job_search;							//search is a collision check of ds_read_rom
+
 void ds_init()
 {
 	DS_PORT &= ~(1<<DS_LINE);
 	DS_DDR &= ~(1<<DS_LINE);
+	DS_PCMSK |= 1<<DS_PCINT;
 }
 
+#if DS_CRC_TABLE == DS_CRC_FULL
+static const uint8_t ds_crc_tbl[256] PROGMEM = {
+	0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83, 0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
+	0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E, 0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
+	0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0, 0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+	0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D, 0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
+	0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5, 0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
+	0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58, 0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+	0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6, 0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
+	0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B, 0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
+	0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F, 0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+	0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92, 0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
+	0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C, 0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
+	0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1, 0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+	0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49, 0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
+	0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4, 0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
+	0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A, 0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+	0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7, 0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
+};
+#elif DS_CRC_TABLE == DS_CRC_NIBBLE
+static const uint8_t ds_crc_tbl[16] PROGMEM = {
+	0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8, 0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+#endif
+
 uint8_t ds_crc(uint8_t crc, uint8_t data)
 {
 	crc ^= data;
+#if DS_CRC_TABLE == DS_CRC_FULL
+	crc = pgm_read_byte(&ds_crc_tbl[crc]);
+#elif DS_CRC_TABLE == DS_CRC_NIBBLE
+	crc = (crc >> 4) ^ pgm_read_byte(&ds_crc_tbl[crc & 0x0F]);
+	crc = (crc >> 4) ^ pgm_read_byte(&ds_crc_tbl[crc & 0x0F]);
+#else
 	for (uint8_t i=0; i<8; i++){
 		if (crc & 0x01)
 		crc = (crc >> 1) ^ 0x8C;
 		else
 		crc >>= 1;
 	}
+#endif
+	return crc;
+}
+
+uint8_t ds_crc_block(uint8_t* data, uint8_t len)
+{
+	uint8_t crc = 0;
+
+	while (len--) crc = ds_crc(crc, *data++);
 	return crc;
 }
 
 uint8_t ds_crc_check(uint8_t* data)
 {
-	uint8_t zero = 0, crc = 0;
-	
-	for(uint8_t i=0;i<8;i++){
-		crc = ds_crc(crc, data[i]);
-	}
+	uint8_t zero = 0, crc = ds_crc_block(data, 8);
 
 	for (uint8_t i=0;i<8;i++) if(data[i] != 0) zero++;
 
@@ -49,52 +119,241 @@ uint8_t ds_in(void)
 	return DS_PIN & (1<<DS_LINE);
 }
 
-void ds_write_bit(uint8_t value)
+static void ds_finish(uint8_t result)
 {
-	if (value)
-	{
-		ds_out(0);
-		_delay_us(5);
+	ds_out(1);
+	TIMSK1 &= ~(1<<OCIE1B);
+	PCICR &= ~(1<<DS_PCIE);
+	timer1_release();
+	ds_state = DS_ST_IDLE;
+	ds_result = result;
+}
+
+//Overdrive slots are shorter than the interrupt latency, so they are timed
+//inline with interrupts off for one slot at a time. Longer recovery between
+//slots is allowed by the protocol.
+static uint8_t ds_od_slot(uint8_t bit)					//writes bit, returns the sampled line
+{
+	uint8_t sreg = SREG;
+	
+	cli();
+	ds_out(0);
+	if(bit){
+		_delay_us(1);
 		ds_out(1);
-		_delay_us(95);
-		}else{
-		ds_out(0);
-		_delay_us(90);
+		_delay_us(0.5);
+		bit = ds_in();
+		_delay_us(8);
+	}else{
+		_delay_us(7.5);
 		ds_out(1);
-		_delay_us(10);
+		_delay_us(2.5);
 	}
+	SREG = sreg;
+	return bit;
 }
 
-uint8_t ds_read_bit()
+static uint8_t ds_od_reset(void)						//results as in ds_finish()
 {
-	uint8_t result;
-
+	uint8_t sreg = SREG, result = 0;
+	
+	_delay_us(2.5);
+	cli();
 	ds_out(0);
-	_delay_us(5);
+	_delay_us(70);
 	ds_out(1);
-	_delay_us(5);
-	result = ds_in();
-	_delay_us(90);
+	_delay_us(8.5);
+	if(ds_in()) result = 2;
+	SREG = sreg;
+	_delay_us(40);
+	if(ds_in() == 0) result = 1;
+	return result;
+}
+
+static uint8_t ds_od_run(uint8_t op, uint8_t* data, uint8_t bits)
+{
+	if(op == DS_OP_RESET) return ds_od_reset();
+	for(uint8_t i=0;i<bits;i++){
+		uint8_t mask = 1 << (i & 0x07);
+		if(op == DS_OP_READ){
+			if(mask == 0x01) data[i >> 3] = 0;
+			if(ds_od_slot(1)) data[i >> 3] |= mask;
+		}else ds_od_slot(data[i >> 3] & mask);
+	}
+	return 0;
+}
+
+static void ds_start(uint8_t op, uint8_t* data, uint8_t bits)
+{
+	ds_wait();
+	if(ds_od && op == DS_OP_PROGRAM){					//program pulses exist at standard speed only,
+		ds_result = DS_READ_ROM_CRC_ERR;				//a device at overdrive would take them for slots
+		return;
+	}
+	if(ds_od){
+		ds_presence = 0;
+		ds_result = ds_od_run(op, data, bits);
+		return;
+	}
+	ds_op = op;
+	ds_buf = data;
+	ds_bits = bits;
+	ds_bit = 0;
+	ds_gap = 0;
+	if(op == DS_OP_WRITE) ds_shift = *data;
+	if(op == DS_OP_PROGRAM){
+		ds_shift = ~*data;
+		ds_gap = ds_program_gap;
+	}
+	ds_result = DS_BUSY;
+	timer1_claim();										//normal mode, 0.5us tick
+	TIFR1 = 1<<OCF1B;
+	if(op == DS_OP_RESET){
+		ds_presence = 0;
+		ds_out(0);
+		OCR1B = TCNT1 + DS_TICKS(900);
+		ds_state = DS_ST_RESET;
+	}else{
+		OCR1B = TCNT1 + DS_TICKS(10);
+		ds_state = DS_ST_SLOT;
+	}
+	TIMSK1 |= 1<<OCIE1B;
+}
+
+//Reset and presence steps are compare matches of their own. A slot is one
+//compare match: drive, release and sample run inside that ISR entry, so no
+//other interrupt can move the sample point. Slots start 100 us apart plus
+//the gap, a slot that is already due when the ISR ran late fires right away.
+static void ds_next(uint16_t ticks)
+{
+	OCR1B += ticks;
+	if((int16_t)(OCR1B - TCNT1) < (int16_t)DS_TICKS(1)) OCR1B = TCNT1 + DS_TICKS(1);
+}
+
+static void ds_next_bit(void)
+{
+	ds_bit++;
+	if(ds_op != DS_OP_READ) ds_shift >>= 1;
+	if((ds_bit & 0x07) == 0 || ds_bit == ds_bits){
+		if(ds_op == DS_OP_READ) *ds_buf = ds_shift >> ((8 - (ds_bit & 0x07)) & 0x07);
+		ds_buf++;
+		if(ds_bit != ds_bits){
+			if(ds_op == DS_OP_WRITE) ds_shift = *ds_buf;
+			if(ds_op == DS_OP_PROGRAM) ds_shift = ~*ds_buf;
+		}
+	}
+	ds_state = DS_ST_SLOT;
+}
 
+ISR(TIMER1_COMPB_vect)
+{
+	switch(ds_state){
+		case DS_ST_RESET:{								//end of reset pulse, arm presence capture
+			ds_out(1);
+			ds_release = OCR1B;
+			PCIFR = 1<<DS_PCIF;
+			PCICR |= 1<<DS_PCIE;
+			ds_next(DS_TICKS(10));
+			ds_state = DS_ST_PRESENCE;
+			break;
+		}
+		case DS_ST_PRESENCE:{
+			if(ds_in() == 0){ds_finish(1); break;}
+			ds_next(DS_TICKS(470));
+			ds_state = DS_ST_RECOVERY;
+			break;
+		}
+		case DS_ST_RECOVERY:{
+			if(ds_in() == 0) ds_finish(1);
+			else if(ds_presence == 0) ds_finish(2);
+			else ds_finish(0);
+			break;
+		}
+		case DS_ST_SLOT:{
+			if(ds_bit == ds_bits){ds_finish(0); break;}
+			ds_out(0);
+			if(ds_op == DS_OP_READ || (ds_shift & 0x01)){	//read or write 1, short pulse
+				_delay_us(5);
+				ds_out(1);
+				if(ds_op == DS_OP_READ){				//sampled 10 us into the slot
+					_delay_us(5);
+					ds_shift >>= 1;
+					if(ds_in()) ds_shift |= 0x80;
+				}
+			}else{
+				_delay_us(60);
+				ds_out(1);
+			}
+			ds_next(DS_TICKS(100) + ds_gap);
+			ds_next_bit();
+			break;
+		}
+	}
+}
+
+ISR(DS_PCINT_vect)
+{
+	if(ds_in() || ds_presence) return;
+	uint16_t time = (uint16_t)(TCNT1 - ds_release) / DS_TICKS(1);
+	ds_presence = time > 255 ? 255 : (time ? time : 1);
+	PCICR &= ~(1<<DS_PCIE);
+}
+
+void ds_start_reset(void)
+{
+	ds_start(DS_OP_RESET, 0, 0);
+}
+
+void ds_start_write(uint8_t* data, uint8_t bits)
+{
+	ds_start(DS_OP_WRITE, data, bits);
+}
+
+void ds_start_read(uint8_t* data, uint8_t bits)
+{
+	ds_start(DS_OP_READ, data, bits);
+}
+
+void ds_start_program(uint8_t* data, uint8_t bits)
+{
+	ds_start(DS_OP_PROGRAM, data, bits);
+}
+
+uint8_t ds_poll(void)
+{
+	return ds_result;
+}
+
+uint8_t ds_wait(void)
+{
+	while(ds_result == DS_BUSY) hal_idle();
+	return ds_result;
+}
+
+void ds_write_bit(uint8_t value)
+{
+	ds_start_write(&value, 1);
+	ds_wait();
+}
+
+uint8_t ds_read_bit()
+{
+	uint8_t result;
+	ds_start_read(&result, 1);
+	ds_wait();
 	return result;
 }
 
 void ds_write_byte(uint8_t data)
 {
-	for (uint8_t loop=0;loop<8;loop++){
-		ds_write_bit(data & 0x01);
-		data >>= 1;
-	}
+	ds_start_write(&data, 8);
+	ds_wait();
 }
 
 void ds_program_byte(uint8_t data)
 {
-	data = ~data;
-	for (uint8_t i=0;i<8;i++){
-		ds_write_bit(data & 0x01);
-		data >>= 1;
-		_delay_ms(10);
-	}
+	ds_start_program(&data, 8);
+	ds_wait();
 }
 
 void ds_program_pulse()
@@ -106,111 +365,317 @@ void ds_program_pulse()
 
 uint8_t ds_read_byte(void)
 {
-	uint8_t result = 0;
-
-	for (uint8_t i=0;i<8;i++){
-		result >>= 1;
-		if (ds_read_bit()) result |= 0x80;
-	}
+	uint8_t result;
+	ds_start_read(&result, 8);
+	ds_wait();
 	return result;
 }
 
 uint8_t ds_reset(void)
 {
-	ds_out(0);
-	_delay_us(900);
-	ds_out(1);
-	_delay_us(10);
-	if(ds_in()==0){return 1;}
-	_delay_us(70);
-	if(ds_in()!=0){return 2;}
-	_delay_us(410);
-	return 0;
+	ds_start_reset();
+	return ds_wait();
+}
+
+static uint8_t ds_presence_time(void)
+{
+	if(ds_result || ds_presence > 99) return 0;
+	return ds_presence;
 }
 
 uint8_t ds_timeslot()
 {
-	uint8_t time;
-	ds_out(0);
-	_delay_us(900);
-	ds_out(1);
-	_delay_us(10);
-	for(time=10;time<100;time++){
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		asm volatile ("nop");
-		if(ds_in() == 0) break;
+	ds_reset();
+	return ds_presence_time();
+}
+
+uint8_t ds_overdrive(void)
+{
+	uint8_t result;
+	
+	ds_od = 0;
+	if((result = ds_reset())) return result;
+	ds_write_byte(ds_cmd_overdrive_skip);
+	ds_od = 1;
+	if(ds_reset() == 0) return 0;
+	ds_od = 0;											//the short reset was a slot for a standard device
+	return ds_reset();
+}
+
+void ds_standard(void)
+{
+	ds_od = 0;
+}
+
+uint8_t ds_speed(void)
+{
+	return ds_od;
+}
+
+static uint8_t ds_read_rom_end(uint8_t result)
+{
+	ds_job = DS_JOB_IDLE;
+	ds_od = 0;
+	if(result == DS_READ_ROM_NO_PRES) return result;
+	for(uint8_t i=0;i<8;i++) ds_job_data[i] = ds_job_rom[i];
+	ds_time = ds_job_time;
+	return result;
+}
+
+void ds_read_rom_start(uint8_t* data)
+{
+	ds_time = 0;
+	ds_job_data = data;
+	ds_job_try = 0;
+	ds_job_od = 1;
+	ds_od = 0;
+	ds_start_reset();
+	ds_job = DS_JOB_RESET;
+}
+
+static uint8_t ds_job_present(void)					//presence time is only measured at standard speed
+{
+	if(ds_od) return ds_poll() == 0;
+	return ( ds_job_time = ds_presence_time() ) >= 10;
+}
+
+static void ds_search_pass(void)
+{
+	ds_start_reset();
+	ds_job = DS_JOB_SEARCH_RESET;
+}
+
+static uint8_t ds_search_end(uint8_t result)
+{
+	if(result != DS_READ_ROM_OK) ds_search_last = DS_SEARCH_DONE;
+	if(ds_job_search == 0){
+		ds_job = DS_JOB_IDLE;
+		if(result == DS_READ_ROM_OK) for(uint8_t i=0;i<8;i++) ds_job_data[i] = ds_search_rom[i];
+		return result;
 	}
-	_delay_us(410);
-	if(ds_in() == 0) return 0;
-	else if(time < 99) return time;
-	return 0;
+	if(result == DS_READ_ROM_OK){						//Read ROM of several devices is the AND of their codes,
+		for(uint8_t i=0;i<8;i++) ds_job_rom[i] = ds_search_rom[i];	//a fork left open means another one answered
+		return ds_read_rom_end(ds_search_last == DS_SEARCH_DONE ? DS_READ_ROM_OK : DS_READ_ROM_MULTI);
+	}
+	ds_job_search = 0;									//the key does not search, equal reads decide
+	ds_job_try = 1;
+	ds_start_reset();
+	ds_job = ds_job_od ? DS_JOB_OD_RESET : DS_JOB_RESET;
+	return DS_BUSY;
+}
+
+static uint8_t ds_job_poll(void)
+{
+	if(ds_poll() == DS_BUSY) return DS_BUSY;
+	switch(ds_job){
+		case DS_JOB_RESET:{
+			if(!ds_job_present()) return ds_read_rom_end(DS_READ_ROM_NO_PRES);
+			ds_start_write(&ds_cmd_read_rom, 8);
+			ds_job = DS_JOB_COMMAND;
+			return DS_BUSY;
+		}
+		case DS_JOB_COMMAND:{
+			ds_start_read(ds_job_try ? ds_job_copy : ds_job_rom, 64);
+			ds_job = DS_JOB_READ;
+			return DS_BUSY;
+		}
+		case DS_JOB_READ:{								//non-standard keys are accepted after 8 equal reads
+			if(ds_job_try == 0){
+				if(ds_crc_check(ds_job_rom) == 0) return ds_read_rom_end(DS_READ_ROM_OK);
+				ds_job_search = 1;						//a bad CRC may be a collision, Search ROM tells
+				ds_search_last = 0;
+				ds_search_pass();
+				return DS_BUSY;
+			}else{
+				for(uint8_t i=0;i<8;i++){
+					if(ds_job_copy[i] == ds_job_rom[i]) continue;
+					if(ds_od == 0) return ds_read_rom_end(DS_READ_ROM_NO_PRES);
+					ds_od = 0;							//not trusted at overdrive, verify again at standard speed
+					ds_job_od = 0;
+					ds_job_try = 0;
+					break;
+				}
+				if(ds_job_try == 8) return ds_read_rom_end(DS_READ_ROM_CRC_ERR);
+			}
+			ds_job_try++;
+			ds_start_reset();
+			ds_job = ds_job_try == 1 && ds_job_od ? DS_JOB_OD_RESET : DS_JOB_RESET;
+			return DS_BUSY;
+		}
+		case DS_JOB_OD_RESET:{							//verify reads go at overdrive if the key takes it
+			if(ds_presence_time() < 10) return ds_read_rom_end(DS_READ_ROM_NO_PRES);
+			ds_start_write(&ds_cmd_overdrive_skip, 8);
+			ds_job = DS_JOB_OD_COMMAND;
+			return DS_BUSY;
+		}
+		case DS_JOB_OD_COMMAND:{
+			ds_od = 1;
+			ds_start_reset();
+			if(ds_poll()){
+				ds_od = 0;
+				ds_start_reset();
+			}
+			ds_job = DS_JOB_RESET;
+			return DS_BUSY;
+		}
+		case DS_JOB_SEARCH_RESET:{
+			if(ds_search_last == DS_SEARCH_DONE || !ds_job_present()) return ds_search_end(DS_READ_ROM_NO_PRES);
+			ds_start_write(&ds_cmd_search_rom, 8);
+			ds_search_bit = 1;
+			ds_search_zero = 0;
+			ds_job = DS_JOB_SEARCH_COMMAND;
+			return DS_BUSY;
+		}
+		case DS_JOB_SEARCH_COMMAND:{					//each bit: the bit and its complement from all devices, then the path taken
+			ds_start_read(&ds_search_pair, 2);
+			ds_job = DS_JOB_SEARCH_BITS;
+			return DS_BUSY;
+		}
+		case DS_JOB_SEARCH_BITS:{
+			uint8_t n = (ds_search_bit - 1) >> 3, mask = 1 << ((ds_search_bit - 1) & 0x07);
+			if(ds_search_pair == 0x03) return ds_search_end(DS_READ_ROM_CRC_ERR);	//nobody answered
+			if(ds_search_pair) ds_search_dir = ds_search_pair & 0x01;
+			else{											//devices differ in this bit
+				if(ds_search_bit < ds_search_last) ds_search_dir = (ds_search_rom[n] & mask) != 0;
+				else ds_search_dir = ds_search_bit == ds_search_last;
+				if(ds_search_dir == 0) ds_search_zero = ds_search_bit;
+			}
+			if(ds_search_dir) ds_search_rom[n] |= mask;
+			else ds_search_rom[n] &= ~mask;
+			ds_start_write(&ds_search_dir, 1);
+			ds_job = DS_JOB_SEARCH_DIR;
+			return DS_BUSY;
+		}
+		case DS_JOB_SEARCH_DIR:{
+			if(ds_search_bit++ < 64){
+				ds_start_read(&ds_search_pair, 2);
+				ds_job = DS_JOB_SEARCH_BITS;
+				return DS_BUSY;
+			}
+			ds_search_last = ds_search_zero ? ds_search_zero : DS_SEARCH_DONE;
+			return ds_search_end(ds_crc_check(ds_search_rom) ? DS_READ_ROM_CRC_ERR : DS_READ_ROM_OK);
+		}
+	}
+	return DS_READ_ROM_NO_PRES;
+}
+
+uint8_t ds_read_rom_poll(void)
+{
+	return ds_job_poll();
+}
+
+uint8_t ds_read_rom_wait(void)
+{
+	uint8_t result;
+	while((result = ds_read_rom_poll()) == DS_BUSY)
+		if(ds_poll() == DS_BUSY) hal_idle();				//overdrive steps end inline, no interrupt would wake us
+	return result;
 }
 
 uint8_t ds_read_rom(uint8_t* data)
 {
-	uint8_t time = 0;
-	ds_time = 0;
-	if(( time = ds_timeslot() ) < 10) return DS_READ_ROM_NO_PRES;
+	ds_read_rom_start(data);
+	return ds_read_rom_wait();
+}
+
+void ds_search_start(uint8_t* data, uint8_t first)
+{
+	ds_job_data = data;
+	ds_job_search = 0;
+	if(first) ds_search_last = 0;
+	ds_search_pass();
+}
+
+uint8_t ds_search_poll(void)
+{
+	return ds_job_poll();
+}
+
+uint8_t ds_search(uint8_t* data, uint8_t first)
+{
+	uint8_t result;
+	
+	ds_search_start(data, first);
+	while((result = ds_search_poll()) == DS_BUSY)
+		if(ds_poll() == DS_BUSY) hal_idle();
+	return result;
+}
+
+//Reads the ROM back bit by bit, at overdrive while the blank type takes it,
+//and stops at the first bit that did not burn. No slot follows that bit: a
+//reset at standard speed ends the transfer and the overdrive of the blank.
+static uint8_t ds_verify_rom(uint8_t* data, uint8_t* overdrive)
+{
+	if(*overdrive){
+		if(ds_overdrive()) return DS_READ_ROM_NO_PRES;
+		*overdrive = ds_od;
+	}else if(ds_reset()) return DS_READ_ROM_NO_PRES;
 	ds_write_byte(0x33);
-	for(uint8_t i=0;i<8;i++) data[i] = ds_read_byte();
-	if(ds_crc_check(data)){
-		for(uint8_t t=0;t<8;t++){
-			if(( time = ds_timeslot() ) < 10) return DS_READ_ROM_NO_PRES;
-			ds_write_byte(0x33);
-			for(uint8_t i=0;i<8;i++)
-				if(data[i] != ds_read_byte()) return DS_READ_ROM_NO_PRES;
-		}
-		ds_time = time;
-		return DS_READ_ROM_CRC_ERR;
+	for(ds_verify_bit=0;ds_verify_bit<64;ds_verify_bit++)
+		if(ds_read_bit() != ((data[ds_verify_bit >> 3] >> (ds_verify_bit & 0x07)) & 0x01)) break;
+	ds_od = 0;
+	if(ds_verify_bit == 64) return DS_READ_ROM_OK;
+	if(*overdrive){										//a mismatch at overdrive is checked again at standard speed,
+		*overdrive = 0;									//starting with that reset
+		return ds_verify_rom(data, overdrive);
 	}
-	ds_time = time;
-	return DS_READ_ROM_OK;
+	ds_reset();
+	return DS_READ_ROM_CRC_ERR;
 }
 
-uint8_t ds_program_RW1990_2(uint8_t* data)
+static uint8_t ds_program_rom(uint8_t* data, uint8_t flag, uint8_t unlock, uint16_t gap, uint8_t* overdrive)
 {
 	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0x1D);
-	ds_write_bit(1);
+	ds_write_byte(flag);
+	ds_write_bit(unlock);
 	_delay_ms(10);
 	if(ds_reset()) return DS_READ_ROM_NO_PRES;
 	ds_write_byte(0xD5);
+	ds_program_gap = DS_TICKS(gap);
 	for(unsigned char i=0;i<8;i++) ds_program_byte(data[i]);
+	ds_program_gap = DS_TICKS(DS_GAP_SAFE);
+	uint8_t result = ds_verify_rom(data, overdrive);
+	if(result != DS_READ_ROM_OK) return result;
 	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0x33);
-	for(uint8_t i=0;i<8;i++) if(data[i] != ds_read_byte()) return DS_READ_ROM_CRC_ERR;
-	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0x1D);
-	ds_write_bit(0);
+	ds_write_byte(flag);
+	ds_write_bit(!unlock);
 	_delay_ms(10);
 	return DS_READ_ROM_OK;
 }
 
+//Writes with the shortest gap that was verified on this blank type so far.
+//DS_GAP_CLEAN verified writes in a row shorten the gap, never below the
+//floor of the blank type. A failed write is repeated with the safe gap at
+//once, and the gap and the floor go to twice the gap that failed, so a
+//weaker blank of the same type is not tried that short again.
+static uint8_t ds_program_adaptive(uint8_t* data, uint8_t flag, uint8_t unlock, uint8_t type)
+{
+	uint16_t* profile = &ds_profile[type];
+	uint16_t* limit = &ds_profile_floor[type];
+	uint8_t result = ds_program_rom(data, flag, unlock, *profile, &ds_profile_od[type]);
+	
+	if(result == DS_READ_ROM_OK){
+		if(++ds_profile_clean[type] < DS_GAP_CLEAN) return result;
+		ds_profile_clean[type] = 0;
+		*profile -= *profile / 4;
+		if(*profile < *limit) *profile = *limit;
+		return result;
+	}
+	ds_profile_clean[type] = 0;
+	if(result == DS_READ_ROM_NO_PRES || *profile >= DS_GAP_SAFE) return result;
+	*profile = *profile < DS_GAP_SAFE / 2 ? *profile * 2 : DS_GAP_SAFE;
+	if(*limit < *profile) *limit = *profile;
+	return ds_program_rom(data, flag, unlock, DS_GAP_SAFE, &ds_profile_od[type]);
+}
+
+uint8_t ds_program_RW1990_2(uint8_t* data)
+{
+	return ds_program_adaptive(data, 0x1D, 1, 1);
+}
+
 uint8_t ds_program_tm08v2(uint8_t* data)
 {
-	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0xD1);
-	ds_write_bit(0);
-	_delay_ms(10);
-	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0xD5);
-	for(unsigned char i=0;i<8;i++) ds_program_byte(data[i]);
-	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0x33);
-	for(uint8_t i=0;i<8;i++) if(data[i] != ds_read_byte()) return DS_READ_ROM_CRC_ERR;
-	if(ds_reset()) return DS_READ_ROM_NO_PRES;
-	ds_write_byte(0xD1);
-	ds_write_bit(1);
-	_delay_ms(10);
-	return DS_READ_ROM_OK;
+	return ds_program_adaptive(data, 0xD1, 0, 0);
 }
 
 uint8_t ds_program_tm2004(uint8_t* data)
@@ -229,4 +694,25 @@ uint8_t ds_program_tm2004(uint8_t* data)
 		crc = i + 1;
 	}
 	return DS_READ_ROM_OK;
+}
+
+uint8_t ds_blank_type(uint8_t* data)					//identifies a blank without programming it
+{
+	//TM2004 answers a memory write with the CRC of command, address and data,
+	//the byte is only burnt by the program pulse, which is not sent here
+	if(ds_reset()) return DS_BLANK_UNKNOWN;
+	ds_write_byte(0x3c);
+	ds_write_byte(0x00);
+	ds_write_byte(0x00);
+	ds_write_byte(data[0]);
+	if(ds_read_byte() == ds_crc(0x65, data[0])) return DS_BLANK_TM2004;
+
+	//RW1990 variants report their record flag, genuine keys ignore the command
+	if(ds_reset()) return DS_BLANK_UNKNOWN;
+	ds_write_byte(0x1e);
+	if(ds_read_byte() != 0xff) return DS_BLANK_RW1990;
+	if(ds_reset()) return DS_BLANK_UNKNOWN;
+	ds_write_byte(0xb5);
+	if(ds_read_byte() != 0xff) return DS_BLANK_TM08;
+	return DS_BLANK_UNKNOWN;
 }
\ No newline at end of file
@@ -6,8 +6,9 @@
  */ 
 #pragma once
 
-enum enum_ds{DS_READ_ROM_OK, DS_READ_ROM_NO_PRES, DS_READ_ROM_CRC_ERR};
+enum enum_ds{DS_READ_ROM_OK, DS_READ_ROM_NO_PRES, DS_READ_ROM_CRC_ERR, DS_BUSY, DS_READ_ROM_MULTI};
 enum enum_TM01{TM01C_DALLAS, TM01C_METAKOM, TM01C_CYFRAL};
+enum enum_ds_blank{DS_BLANK_UNKNOWN, DS_BLANK_TM2004, DS_BLANK_TM08, DS_BLANK_RW1990};
 
 #define DS_PORT PORTC
 #define DS_DDR DDRC
@@ -15,12 +16,38 @@ enum enum_TM01{TM01C_DALLAS, TM01C_METAKOM, TM01C_CYFRAL};
 
 #define DS_LINE 0
 
+//pin change interrupt of DS_LINE, captures the presence pulse
+#define DS_PCMSK PCMSK1
+#define DS_PCIE  PCIE1
+#define DS_PCIF  PCIF1
+#define DS_PCINT PCINT8
+#define DS_PCINT_vect PCINT1_vect
+
+//CRC variant: bitwise, 16-byte nibble table or 256-byte table in flash
+#define DS_CRC_BITWISE 0
+#define DS_CRC_NIBBLE 1
+#define DS_CRC_FULL 2
+#ifndef DS_CRC_TABLE
+#define DS_CRC_TABLE DS_CRC_FULL
+#endif
+
+//gap after each program slot of RW1990 and TM08 blanks, in us, the shortest
+//one each blank type is tried with and the verified writes in a row that
+//shorten the gap by a quarter
+#define DS_GAP_SAFE 10000
+#define DS_GAP_MIN_TM08 4000								//no datasheet minimum, 40% of the 10 ms the original routine waited
+#define DS_GAP_MIN_RW1990 2000							//same origin, 20% of 10 ms, not measured; a failed write raises either floor
+#define DS_GAP_CLEAN 4
+
 uint8_t ds_time;
+uint8_t ds_verify_bit;									//first bit that read back wrong after programming, 64 if none
 
 void ds_init();
 
 uint8_t ds_crc(uint8_t crc, uint8_t data);
 
+uint8_t ds_crc_block(uint8_t* data, uint8_t len);
+
 uint8_t ds_crc_check(uint8_t* data);
 
 void ds_out(uint8_t data_byte);
@@ -45,7 +72,53 @@ uint8_t ds_read_byte(void);
 
 uint8_t ds_reset(void);
 
-uint8_t ds_read_rom();
+//Overdrive speed, about 8x faster slots. ds_overdrive() resets the line and
+//sends Overdrive Skip ROM, returns as ds_reset() with the device ready for a
+//ROM command; ds_speed() tells whether it switched or stayed at standard speed.
+//ds_standard() goes back, the next standard reset returns the device as well.
+//Programming is refused with DS_READ_ROM_CRC_ERR until then.
+uint8_t ds_overdrive(void);
+
+void ds_standard(void);
+
+uint8_t ds_speed(void);
+
+//Background 1-Wire engine. Slots are timed by Timer1 compare B (clk/8),
+//Timer1 is claimed from the sound module for the duration of an operation.
+//Lengths are given in bits, ds_poll() returns DS_BUSY until the operation ends.
+//A slot runs inside one ISR entry, at most 60 us, the time between slots does
+//not block.
+void ds_start_reset(void);
+
+void ds_start_write(uint8_t* data, uint8_t bits);
+
+void ds_start_read(uint8_t* data, uint8_t bits);
+
+void ds_start_program(uint8_t* data, uint8_t bits);
+
+uint8_t ds_poll(void);
+
+uint8_t ds_wait(void);
+
+//Read ROM as a job, its stages advance on each ds_read_rom_poll() call.
+void ds_read_rom_start(uint8_t* data);
+
+uint8_t ds_read_rom_poll(void);
+
+uint8_t ds_read_rom_wait(void);
+
+uint8_t ds_read_rom(uint8_t* data);
+
+//Search ROM (0xF0) enumerates every device on the line, one ROM per pass.
+//first starts over, then each call returns the next device: DS_READ_ROM_OK,
+//DS_READ_ROM_NO_PRES after the last one, DS_READ_ROM_CRC_ERR if the search broke.
+//Runs at the current speed. ds_read_rom() uses it on a bad CRC and reports
+//DS_READ_ROM_MULTI for several keys.
+void ds_search_start(uint8_t* data, uint8_t first);
+
+uint8_t ds_search_poll(void);
+
+uint8_t ds_search(uint8_t* data, uint8_t first);
 
 void ds_program_byte(uint8_t data);
 
@@ -53,4 +126,6 @@ uint8_t ds_program_RW1990_2(uint8_t* data);
 
 uint8_t ds_program_tm08v2(uint8_t* data);
 
-uint8_t ds_program_tm2004(uint8_t* data);
\ No newline at end of file
+uint8_t ds_program_tm2004(uint8_t* data);
+
+uint8_t ds_blank_type(uint8_t* data);
\ No newline at end of file
@@ -81,6 +81,12 @@
 #define FAT32_CLUSTER_LAST_MIN 0x0ffffff8
 #define FAT32_CLUSTER_LAST_MAX 0x0fffffff
 
+#define FAT_CLUSTER_COUNT_UNKNOWN ((cluster_t) -1)
+
+#define FAT32_FSINFO_LEAD_SIG 0x41615252
+#define FAT32_FSINFO_STRUCT_SIG 0x61417272
+#define FAT32_FSINFO_STRUCT_OFFSET 484
+
 #define FAT_DIRENTRY_DELETED 0xe5
 #define FAT_DIRENTRY_LFNLAST (1 << 6)
 #define FAT_DIRENTRY_LFNSEQMASK ((1 << 6) - 1)
@@ -152,11 +158,73 @@ struct fat_header_struct
 #endif
 };
 
+#if FAT_EXTENT_COUNT
+struct fat_extent_struct
+{
+    /* first cluster of a contiguous run */
+    cluster_t cluster;
+    /* index of this cluster within the chain */
+    cluster_t index;
+};
+
+struct fat_extent_cache_struct
+{
+    /* first cluster of the cached chain, 0 if the cache is empty */
+    cluster_t first;
+    /* number of chain clusters covered by the runs */
+    cluster_t end;
+    uint8_t count;
+    struct fat_extent_struct extents[FAT_EXTENT_COUNT];
+};
+#endif
+
+struct fat_chain_cursor_struct
+{
+    /* first cluster of the chain, 0 if the cursor is unset */
+    cluster_t first;
+    /* position and number of the cluster found by the last lookup */
+    cluster_t index;
+    cluster_t cluster;
+};
+
+#if FAT_DIR_CACHE_COUNT
+struct fat_dir_cache_struct
+{
+    /* hash of the entry name, 0 if the slot is empty */
+    uint16_t name_hash;
+    /* first cluster of the directory holding the entry */
+    cluster_t dir_cluster;
+    /* directory handle position right before the entry */
+    cluster_t entry_cluster;
+    uint16_t entry_offset;
+};
+#endif
+
 struct fat_fs_struct
 {
     struct partition_struct* partition;
     struct fat_header_struct header;
     cluster_t cluster_free;
+    /* number of free clusters, FAT_CLUSTER_COUNT_UNKNOWN until counted */
+    cluster_t cluster_free_count;
+#if FAT_FAT32_SUPPORT
+    /* offset of the FSInfo sector, 0 if there is none */
+    offset_t fsinfo_offset;
+#endif
+#if FAT_FREE_WINDOW
+    /* first cluster of the window, free_window_end is 0 if it is empty */
+    cluster_t free_window_start;
+    cluster_t free_window_end;
+    uint8_t free_window[FAT_FREE_WINDOW / 8];
+#endif
+#if FAT_EXTENT_COUNT
+    struct fat_extent_cache_struct extent_cache;
+#endif
+    struct fat_chain_cursor_struct chain_cursor;
+#if FAT_DIR_CACHE_COUNT
+    struct fat_dir_cache_struct dir_cache[FAT_DIR_CACHE_COUNT];
+    uint8_t dir_cache_next;
+#endif
 };
 
 struct fat_file_struct
@@ -165,6 +233,9 @@ struct fat_file_struct
     struct fat_dir_entry_struct dir_entry;
     offset_t pos;
     cluster_t pos_cluster;
+#if FAT_WRITE_SUPPORT && !FAT_DELAY_DIRENTRY_UPDATE
+    uint8_t dir_entry_delayed;
+#endif
 };
 
 struct fat_dir_struct
@@ -191,6 +262,25 @@ struct fat_usage_count_callback_arg
     uintptr_t buffer_size;
 };
 
+struct fat_read_file_interval_callback_arg
+{
+    fat_read_interval_handler_t callback;
+    void* p;
+    uintptr_t interval;
+    offset_t offset;
+    offset_t pos;
+    uintptr_t bytes_read;
+    uint8_t finished;
+};
+
+#if FAT_FREE_WINDOW
+struct fat_free_window_callback_arg
+{
+    struct fat_fs_struct* fs;
+    uint16_t index;
+};
+#endif
+
 #if !USE_DYNAMIC_MEMORY
 static struct fat_fs_struct fat_fs_handles[FAT_FS_COUNT];
 static struct fat_file_struct fat_file_handles[FAT_FILE_COUNT];
@@ -199,8 +289,15 @@ static struct fat_dir_struct fat_dir_handles[FAT_DIR_COUNT];
 
 static uint8_t fat_read_header(struct fat_fs_struct* fs);
 static cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
+static cluster_t fat_get_chain_cluster(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t index);
 static offset_t fat_cluster_offset(const struct fat_fs_struct* fs, cluster_t cluster_num);
+static uint8_t fat_read_file_interval_callback(uint8_t* buffer, offset_t offset, void* p);
+static uint8_t fat_read_file_piece_callback(uint8_t* buffer, offset_t offset, void* p);
 static uint8_t fat_dir_entry_read_callback(uint8_t* buffer, offset_t offset, void* p);
+#if FAT_DIR_CACHE_COUNT
+static uint16_t fat_dir_cache_hash(const char* name);
+static void fat_dir_cache_clear(struct fat_fs_struct* fs);
+#endif
 #if FAT_LFN_SUPPORT
 static uint8_t fat_calc_83_checksum(const uint8_t* file_name_83);
 #endif
@@ -211,6 +308,14 @@ static uint8_t fat_get_fs_free_32_callback(uint8_t* buffer, offset_t offset, voi
 #endif
 
 #if FAT_WRITE_SUPPORT
+static uint8_t fat_get_cluster_free(struct fat_fs_struct* fs, cluster_t cluster_num, uint8_t* is_free);
+static void fat_set_cluster_free(struct fat_fs_struct* fs, cluster_t cluster_num, uint8_t is_free);
+#if FAT_FREE_WINDOW
+static uint8_t fat_free_window_callback(uint8_t* buffer, offset_t offset, void* p);
+#endif
+#if FAT_FAT32_SUPPORT
+static void fat_write_fsinfo(const struct fat_fs_struct* fs);
+#endif
 static cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
 static uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_terminate_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
@@ -318,7 +423,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
 
     /* read fat parameters */
 #if FAT_FAT32_SUPPORT
-    uint8_t buffer[37];
+    uint8_t buffer[39];
 #else
     uint8_t buffer[25];
 #endif
@@ -337,6 +442,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
 #if FAT_FAT32_SUPPORT
     uint32_t sectors_per_fat32 = read32(&buffer[0x19]);
     uint32_t cluster_root_dir = read32(&buffer[0x21]);
+    uint16_t fsinfo_sector = read16(&buffer[0x25]);
 #endif
 
     if(sector_count == 0)
@@ -382,6 +488,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
     /* fill header information */
     struct fat_header_struct* header = &fs->header;
     memset(header, 0, sizeof(*header));
+    fs->cluster_free_count = FAT_CLUSTER_COUNT_UNKNOWN;
 
     header->size = (offset_t) sector_count * bytes_per_sector;
 
@@ -417,6 +524,28 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
                                       (offset_t) fat_copies * sectors_per_fat32 * bytes_per_sector;
 
         header->root_dir_cluster = cluster_root_dir;
+
+        /* take the allocation hints from the FSInfo sector, if valid */
+        if(fsinfo_sector > 0 && fsinfo_sector < reserved_sectors)
+        {
+            offset_t fsinfo_offset = partition_offset + (offset_t) fsinfo_sector * bytes_per_sector;
+            uint8_t fsinfo[12];
+            if(partition->device_read(fsinfo_offset, fsinfo, 4) &&
+               read32(fsinfo) == FAT32_FSINFO_LEAD_SIG &&
+               partition->device_read(fsinfo_offset + FAT32_FSINFO_STRUCT_OFFSET, fsinfo, sizeof(fsinfo)) &&
+               read32(fsinfo) == FAT32_FSINFO_STRUCT_SIG
+              )
+            {
+                uint32_t free_count = read32(&fsinfo[4]);
+                uint32_t next_free = read32(&fsinfo[8]);
+
+                fs->fsinfo_offset = fsinfo_offset;
+                if(free_count <= data_cluster_count)
+                    fs->cluster_free_count = free_count;
+                if(next_free >= 2 && next_free < data_cluster_count + 2)
+                    fs->cluster_free = next_free;
+            }
+        }
     }
 #endif
 
@@ -478,6 +607,250 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
     return cluster_num;
 }
 
+/**
+ * \ingroup fat_fs
+ * Retrieves a cluster at a given position within a cluster chain.
+ *
+ * Contiguous runs of the chain are remembered while walking it, so
+ * later lookups within the same chain need no FAT access. A walk starts
+ * where the last lookup of the chain ended if that lies on the way, so
+ * sequential access reads one FAT entry per cluster even beyond the
+ * cached runs.
+ *
+ * \param[in] fs The filesystem for which to determine the cluster.
+ * \param[in] cluster_num The first cluster of the chain.
+ * \param[in] index The position of the wanted cluster within the chain.
+ * \returns The wanted cluster, or 0 if the chain is shorter.
+ */
+cluster_t fat_get_chain_cluster(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t index)
+{
+    cluster_t first = cluster_num;
+    cluster_t i = 0;
+#if FAT_EXTENT_COUNT
+    struct fat_extent_cache_struct* cache = &fs->extent_cache;
+    if(cache->first != first)
+    {
+        cache->first = first;
+        cache->end = 1;
+        cache->count = 1;
+        cache->extents[0].cluster = first;
+        cache->extents[0].index = 0;
+    }
+
+    if(index < cache->end)
+    {
+        /* binary search for the run containing the cluster */
+        uint8_t low = 0;
+        uint8_t high = cache->count;
+        while(high - low > 1)
+        {
+            uint8_t mid = (low + high) / 2;
+            if(cache->extents[mid].index <= index)
+                low = mid;
+            else
+                high = mid;
+        }
+        return cache->extents[low].cluster + (index - cache->extents[low].index);
+    }
+
+    /* continue walking from the last cached cluster */
+    struct fat_extent_struct* extent = &cache->extents[cache->count - 1];
+    i = cache->end - 1;
+    cluster_num = extent->cluster + (i - extent->index);
+#endif
+
+    /* or from the last lookup, if it got further */
+    struct fat_chain_cursor_struct* cursor = &fs->chain_cursor;
+    if(cursor->first == first && cursor->index > i && cursor->index <= index)
+    {
+        i = cursor->index;
+        cluster_num = cursor->cluster;
+    }
+
+    while(i < index)
+    {
+        cluster_t cluster_num_next = fat_get_next_cluster(fs, cluster_num);
+        if(!cluster_num_next)
+            return 0;
+        ++i;
+
+#if FAT_EXTENT_COUNT
+        if(cache->end == i)
+        {
+            if(cluster_num_next == cluster_num + 1)
+            {
+                ++cache->end;
+            }
+            else if(cache->count < FAT_EXTENT_COUNT)
+            {
+                extent = &cache->extents[cache->count++];
+                extent->cluster = cluster_num_next;
+                extent->index = i;
+                ++cache->end;
+            }
+        }
+#endif
+
+        cluster_num = cluster_num_next;
+    }
+
+    cursor->first = first;
+    cursor->index = index;
+    cursor->cluster = cluster_num;
+    return cluster_num;
+}
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Checks whether a cluster is free.
+ *
+ * With a free cluster window configured, the answer comes from the
+ * RAM bitmap, which is reloaded from the FAT when the cluster lies
+ * outside of it.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The cluster to check.
+ * \param[out] is_free Set to 1 if the cluster is free, 0 otherwise.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_get_cluster_free(struct fat_fs_struct* fs, cluster_t cluster_num, uint8_t* is_free)
+{
+    offset_t fat_offset = fs->header.fat_offset;
+#if FAT_FAT32_SUPPORT
+    uint8_t entry_size = fs->partition->type == PARTITION_TYPE_FAT32 ? 4 : 2;
+#else
+    uint8_t entry_size = 2;
+#endif
+
+#if FAT_FREE_WINDOW
+    if(cluster_num < fs->free_window_start || cluster_num >= fs->free_window_end)
+    {
+        /* load the window holding the cluster */
+        cluster_t cluster_count = fs->header.fat_size / entry_size;
+        cluster_t start = cluster_num - cluster_num % FAT_FREE_WINDOW;
+        cluster_t end = start + FAT_FREE_WINDOW;
+        if(end > cluster_count || end < start)
+            end = cluster_count;
+
+        uint8_t buffer[16];
+        struct fat_free_window_callback_arg arg;
+        arg.fs = fs;
+        arg.index = 0;
+
+        /* entries after the last full buffer are left marked as used */
+        uintptr_t length = (uintptr_t) (end - start) * entry_size;
+        fs->free_window_end = 0;
+        memset(fs->free_window, 0, sizeof(fs->free_window));
+        if(length >= sizeof(buffer) &&
+           !fs->partition->device_read_interval_stream(fat_offset + (offset_t) start * entry_size,
+                                                       buffer,
+                                                       sizeof(buffer),
+                                                       length,
+                                                       fat_free_window_callback,
+                                                       &arg
+                                                      )
+          )
+            return 0;
+
+        fs->free_window_start = start;
+        fs->free_window_end = end;
+    }
+
+    cluster_t bit = cluster_num - fs->free_window_start;
+    *is_free = (fs->free_window[bit / 8] >> (bit % 8)) & 1;
+    return 1;
+#else
+    uint8_t buffer[4];
+    if(!fs->partition->device_read(fat_offset + (offset_t) cluster_num * entry_size, buffer, entry_size))
+        return 0;
+
+    *is_free = entry_size == 2 ? read16(buffer) == FAT16_CLUSTER_FREE : read32(buffer) == FAT32_CLUSTER_FREE;
+    return 1;
+#endif
+}
+
+/**
+ * \ingroup fat_fs
+ * Records a change of a cluster's free state.
+ *
+ * Keeps the free cluster window and the free cluster count
+ * in sync with a FAT entry which has just been written.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The cluster which has been allocated or freed.
+ * \param[in] is_free 1 if the cluster has been freed, 0 if it has been allocated.
+ */
+void fat_set_cluster_free(struct fat_fs_struct* fs, cluster_t cluster_num, uint8_t is_free)
+{
+#if FAT_FREE_WINDOW
+    if(cluster_num >= fs->free_window_start && cluster_num < fs->free_window_end)
+    {
+        cluster_t bit = cluster_num - fs->free_window_start;
+        if(is_free)
+            fs->free_window[bit / 8] |= 1 << (bit % 8);
+        else
+            fs->free_window[bit / 8] &= ~(1 << (bit % 8));
+    }
+#endif
+
+    if(fs->cluster_free_count != FAT_CLUSTER_COUNT_UNKNOWN)
+    {
+        if(is_free)
+            ++fs->cluster_free_count;
+        else
+            --fs->cluster_free_count;
+    }
+}
+
+#if DOXYGEN || FAT_FREE_WINDOW
+/**
+ * \ingroup fat_fs
+ * Callback function used for loading the free cluster window.
+ */
+uint8_t fat_free_window_callback(uint8_t* buffer, offset_t offset, void* p)
+{
+    struct fat_free_window_callback_arg* arg = (struct fat_free_window_callback_arg*) p;
+    struct fat_fs_struct* fs = arg->fs;
+    (void) offset;
+#if FAT_FAT32_SUPPORT
+    uint8_t entry_size = fs->partition->type == PARTITION_TYPE_FAT32 ? 4 : 2;
+#else
+    uint8_t entry_size = 2;
+#endif
+
+    for(uint8_t i = 0; i < 16; i += entry_size, ++arg->index)
+    {
+        uint8_t is_free = entry_size == 2 ? read16(&buffer[i]) == FAT16_CLUSTER_FREE : read32(&buffer[i]) == FAT32_CLUSTER_FREE;
+        if(is_free)
+            fs->free_window[arg->index / 8] |= 1 << (arg->index % 8);
+    }
+
+    return 1;
+}
+#endif
+
+#if DOXYGEN || FAT_FAT32_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Stores the free cluster count and the next free cluster hint
+ * within the FSInfo sector of a FAT32 filesystem.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ */
+void fat_write_fsinfo(const struct fat_fs_struct* fs)
+{
+    if(!fs->fsinfo_offset)
+        return;
+
+    uint8_t buffer[8];
+    write32(&buffer[0], fs->cluster_free_count == FAT_CLUSTER_COUNT_UNKNOWN ? 0xffffffff : fs->cluster_free_count);
+    write32(&buffer[4], fs->cluster_free ? fs->cluster_free : 0xffffffff);
+    fs->partition->device_write(fs->fsinfo_offset + FAT32_FSINFO_STRUCT_OFFSET + 4, buffer, sizeof(buffer));
+}
+#endif
+#endif
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_fs
@@ -495,7 +868,6 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
     if(!fs)
         return 0;
 
-    device_read_t device_read = fs->partition->device_read;
     device_write_t device_write = fs->partition->device_write;
     offset_t fat_offset = fs->header.fat_offset;
     cluster_t count_left = count;
@@ -519,36 +891,26 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
         if(cluster_current < 2 || cluster_current >= cluster_count)
             cluster_current = 2;
 
-#if FAT_FAT32_SUPPORT
-        if(is_fat32)
-        {
-            if(!device_read(fat_offset + (offset_t) cluster_current * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
-                return 0;
-        }
-        else
-#endif
+        /* check if this is a free cluster */
+        uint8_t is_free;
+        if(!fat_get_cluster_free(fs, cluster_current, &is_free))
+            return 0;
+        if(!is_free)
+            continue;
+
+        /* If we don't need this free cluster for the
+         * current allocation, we keep it in mind for
+         * the next time.
+         */
+        if(count_left == 0)
         {
-            if(!device_read(fat_offset + (offset_t) cluster_current * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
-                return 0;
+            fs->cluster_free = cluster_current;
+            break;
         }
 
 #if FAT_FAT32_SUPPORT
         if(is_fat32)
         {
-            /* check if this is a free cluster */
-            if(fat_entry32 != HTOL32(FAT32_CLUSTER_FREE))
-                continue;
-
-            /* If we don't need this free cluster for the
-             * current allocation, we keep it in mind for
-             * the next time.
-             */
-            if(count_left == 0)
-            {
-                fs->cluster_free = cluster_current;
-                break;
-            }
-
             /* allocate cluster */
             if(cluster_next == 0)
                 fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
@@ -561,20 +923,6 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
         else
 #endif
         {
-            /* check if this is a free cluster */
-            if(fat_entry16 != HTOL16(FAT16_CLUSTER_FREE))
-                continue;
-
-            /* If we don't need this free cluster for the
-             * current allocation, we keep it in mind for
-             * the next time.
-             */
-            if(count_left == 0)
-            {
-                fs->cluster_free = cluster_current;
-                break;
-            }
-
             /* allocate cluster */
             if(cluster_next == 0)
                 fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
@@ -585,6 +933,7 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
                 break;
         }
 
+        fat_set_cluster_free(fs, cluster_current, 0);
         cluster_next = cluster_current;
         --count_left;
     }
@@ -617,6 +966,11 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
             }
         }
 
+#if FAT_FAT32_SUPPORT
+        if(is_fat32)
+            fat_write_fsinfo(fs);
+#endif
+
         return cluster_next;
 
     } while(0);
@@ -653,6 +1007,12 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
     if(!fs || cluster_num < 2)
         return 0;
 
+#if FAT_EXTENT_COUNT
+    /* the cached chain may lose clusters */
+    fs->extent_cache.first = 0;
+#endif
+    fs->chain_cursor.first = 0;
+
     offset_t fat_offset = fs->header.fat_offset;
 #if FAT_FAT32_SUPPORT
     if(fs->partition->type == PARTITION_TYPE_FAT32)
@@ -685,7 +1045,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             /* free cluster */
             fat_entry = HTOL32(FAT32_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_set_cluster_free(fs, cluster_num, 1);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -693,6 +1054,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             cluster_num = cluster_num_next;
         }
+
+        fat_write_fsinfo(fs);
     }
     else
 #endif
@@ -717,9 +1080,16 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
             if(cluster_num_next >= FAT16_CLUSTER_LAST_MIN && cluster_num_next <= FAT16_CLUSTER_LAST_MAX)
                 cluster_num_next = 0;
 
+            /* We know we will free the cluster, so remember it as
+             * free for the next allocation.
+             */
+            if(!fs->cluster_free)
+                fs->cluster_free = cluster_num;
+
             /* free cluster */
             fat_entry = HTOL16(FAT16_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_set_cluster_free(fs, cluster_num, 1);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -949,6 +1319,9 @@ struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat
     fd->fs = fs;
     fd->pos = 0;
     fd->pos_cluster = dir_entry->cluster;
+#if FAT_WRITE_SUPPORT && !FAT_DELAY_DIRENTRY_UPDATE
+    fd->dir_entry_delayed = 0;
+#endif
 
     return fd;
 }
@@ -967,6 +1340,10 @@ void fat_close_file(struct fat_file_struct* fd)
 #if FAT_DELAY_DIRENTRY_UPDATE
         /* write directory entry */
         fat_write_dir_entry(fd->fs, &fd->dir_entry);
+#elif FAT_WRITE_SUPPORT
+        /* write directory entry delayed by appends */
+        if(fd->dir_entry_delayed)
+            fat_write_dir_entry(fd->fs, &fd->dir_entry);
 #endif
 
 #if USE_DYNAMIC_MEMORY
@@ -1021,14 +1398,9 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
 
         if(fd->pos)
         {
-            uint32_t pos = fd->pos;
-            while(pos >= cluster_size)
-            {
-                pos -= cluster_size;
-                cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
-                if(!cluster_num)
-                    return -1;
-            }
+            cluster_num = fat_get_chain_cluster(fd->fs, cluster_num, fd->pos / cluster_size);
+            if(!cluster_num)
+                return -1;
         }
     }
 
@@ -1042,7 +1414,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
             copy_length = buffer_left;
 
         /* read data */
-        if(!fd->fs->partition->device_read(cluster_offset, buffer, copy_length))
+        if(!fd->fs->partition->device_read_stream(cluster_offset, buffer, copy_length))
             return buffer_len - buffer_left;
 
         /* calculate new file position */
@@ -1053,7 +1425,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(first_cluster_offset + copy_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            if((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+            if((cluster_num = fat_get_chain_cluster(fd->fs, fd->dir_entry.cluster, fd->pos / cluster_size)))
             {
                 first_cluster_offset = 0;
             }
@@ -1071,6 +1443,157 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
     return buffer_len;
 }
 
+/**
+ * \ingroup fat_file
+ * Reads fixed size units of a file and hands each of them to a callback.
+ *
+ * Reading starts at the current file location. Runs of consecutive
+ * clusters are read in a single device_read_interval_stream call, so
+ * the units go from the device straight into \c buffer and on to the
+ * callback. Units crossing the border to a cluster elsewhere on the
+ * disk are received in pieces the same way.
+ *
+ * Trailing data shorter than \c interval is not read.
+ *
+ * \note Within the callback function, you can not access the file system.
+ *
+ * \param[in] fd The file handle of the file from which to read.
+ * \param[in] buffer Pointer to a buffer which is at least interval bytes in size.
+ * \param[in] interval The size of a unit.
+ * \param[in] length The number of bytes to read altogether.
+ * \param[in] callback The function to call for every unit.
+ * \param[in] p An opaque pointer directly passed to the callback function.
+ * \returns The number of bytes handed to the callback or -1 on failure.
+ * \see fat_read_file
+ */
+intptr_t fat_read_file_interval(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t interval, uintptr_t length, fat_read_interval_handler_t callback, void* p)
+{
+    /* check arguments */
+    if(!fd || !buffer || interval < 1 || !callback)
+        return -1;
+
+    /* determine number of bytes to read */
+    if(fd->pos + length > fd->dir_entry.file_size)
+        length = fd->dir_entry.file_size - fd->pos;
+
+    uint16_t cluster_size = fd->fs->header.cluster_size;
+    uintptr_t length_left = length;
+    struct fat_read_file_interval_callback_arg arg;
+    arg.callback = callback;
+    arg.p = p;
+    arg.interval = interval;
+
+    while(length_left >= interval)
+    {
+        /* find cluster in which to continue reading */
+        cluster_t cluster_index = fd->pos / cluster_size;
+        cluster_t cluster_num = fat_get_chain_cluster(fd->fs, fd->dir_entry.cluster, cluster_index);
+        if(!cluster_num)
+            return -1;
+
+        /* extend the run up to the next gap in the chain */
+        uint16_t first_cluster_offset = (uint16_t) (fd->pos & (cluster_size - 1));
+        uintptr_t run_length = cluster_size - first_cluster_offset;
+        while(run_length < length_left && run_length <= UINTPTR_MAX - cluster_size)
+        {
+            ++cluster_index;
+            if(fat_get_chain_cluster(fd->fs, fd->dir_entry.cluster, cluster_index) != cluster_num + (run_length + first_cluster_offset) / cluster_size)
+                break;
+            run_length += cluster_size;
+        }
+        if(run_length > length_left)
+            run_length = length_left;
+
+        if(run_length < interval)
+        {
+            /* the unit crosses the border to a cluster elsewhere on the disk,
+             * receive it piece by piece, the first piece continues the open
+             * transmission and the FAT sector stays cached for the next run
+             */
+            uintptr_t filled = 0;
+            while(filled < interval)
+            {
+                uint16_t cluster_offset = (uint16_t) (fd->pos & (cluster_size - 1));
+                uintptr_t piece_length = cluster_size - cluster_offset;
+                if(piece_length > interval - filled)
+                    piece_length = interval - filled;
+
+                cluster_num = fat_get_chain_cluster(fd->fs, fd->dir_entry.cluster, fd->pos / cluster_size);
+                if(!cluster_num ||
+                   !fd->fs->partition->device_read_interval_stream(fat_cluster_offset(fd->fs, cluster_num) + cluster_offset,
+                                                                   buffer + filled,
+                                                                   piece_length,
+                                                                   piece_length,
+                                                                   fat_read_file_piece_callback,
+                                                                   0
+                                                                  )
+                  )
+                    return -1;
+
+                filled += piece_length;
+                fd->pos += piece_length;
+            }
+            fd->pos_cluster = 0;
+            length_left -= interval;
+            if(!callback(buffer, fd->pos - interval, p))
+                break;
+            continue;
+        }
+
+        arg.offset = fat_cluster_offset(fd->fs, cluster_num) + first_cluster_offset;
+        arg.pos = fd->pos;
+        arg.bytes_read = 0;
+        arg.finished = 0;
+        if(!fd->fs->partition->device_read_interval_stream(arg.offset,
+                                                           buffer,
+                                                           interval,
+                                                           run_length - run_length % interval,
+                                                           fat_read_file_interval_callback,
+                                                           &arg
+                                                          )
+          )
+            return -1;
+
+        fd->pos += arg.bytes_read;
+        fd->pos_cluster = 0;
+        length_left -= arg.bytes_read;
+
+        if(arg.finished)
+            break;
+    }
+
+    return length - length_left;
+}
+
+/**
+ * \ingroup fat_file
+ * Callback function for passing units read by fat_read_file_interval().
+ */
+uint8_t fat_read_file_interval_callback(uint8_t* buffer, offset_t offset, void* p)
+{
+    struct fat_read_file_interval_callback_arg* arg = p;
+
+    arg->bytes_read = offset - arg->offset + arg->interval;
+    if(arg->callback(buffer, arg->pos + (offset - arg->offset), arg->p))
+        return 1;
+
+    arg->finished = 1;
+    return 0;
+}
+
+/**
+ * \ingroup fat_file
+ * Callback function for the pieces of units assembled by fat_read_file_interval().
+ */
+uint8_t fat_read_file_piece_callback(uint8_t* buffer, offset_t offset, void* p)
+{
+    (void) buffer;
+    (void) offset;
+    (void) p;
+
+    return 1;
+}
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_file
@@ -1097,6 +1620,10 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
     uintptr_t buffer_left = buffer_len;
     uint16_t first_cluster_offset = (uint16_t) (fd->pos & (cluster_size - 1));
 
+    /* appends are streamed to the device */
+    uint8_t append = fd->pos == fd->dir_entry.file_size;
+    device_write_t device_write = append ? fd->fs->partition->device_write_stream : fd->fs->partition->device_write;
+
     /* find cluster in which to start writing */
     if(!cluster_num)
     {
@@ -1151,7 +1678,7 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
             write_length = buffer_left;
 
         /* write data which fits into the current cluster */
-        if(!fd->fs->partition->device_write(cluster_offset, buffer, write_length))
+        if(!device_write(cluster_offset, buffer, write_length))
             break;
 
         /* calculate new file position */
@@ -1191,8 +1718,10 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         fd->dir_entry.file_size = fd->pos;
 
 #if !FAT_DELAY_DIRENTRY_UPDATE
-        /* write directory entry */
-        if(!fat_write_dir_entry(fd->fs, &fd->dir_entry))
+        /* write directory entry, after appends when the file is closed */
+        if(append)
+            fd->dir_entry_delayed = 1;
+        else if(!fat_write_dir_entry(fd->fs, &fd->dir_entry))
         {
             /* We do not return an error here since we actually wrote
              * some data to disk. So we calculate the amount of data
@@ -1571,6 +2100,108 @@ uint8_t fat_reset_dir(struct fat_dir_struct* dd)
     return 1;
 }
 
+/**
+ * \ingroup fat_dir
+ * Searches a directory for an entry with the given name.
+ *
+ * Names found before are looked up in a small cache which remembers
+ * the position of their directory entries, so only the entry itself
+ * is read instead of the whole directory. The cache is dropped
+ * whenever directory entries are created or deleted.
+ *
+ * The directory handle is reset on return.
+ *
+ * \param[in] dd The descriptor of the directory to search.
+ * \param[in] name The name of the entry to search for.
+ * \param[out] dir_entry Pointer to a buffer into which to write the directory entry information.
+ * \returns 0 if the entry was not found, 1 on success.
+ * \see fat_read_dir
+ */
+uint8_t fat_find_dir_entry(struct fat_dir_struct* dd, const char* name, struct fat_dir_entry_struct* dir_entry)
+{
+    if(!dd || !name || !dir_entry)
+        return 0;
+
+#if FAT_DIR_CACHE_COUNT
+    struct fat_fs_struct* fs = dd->fs;
+    uint16_t name_hash = fat_dir_cache_hash(name);
+    struct fat_dir_cache_struct* slot = fs->dir_cache;
+    for(uint8_t i = 0; i < FAT_DIR_CACHE_COUNT; ++i, ++slot)
+    {
+        if(slot->name_hash != name_hash || slot->dir_cluster != dd->dir_entry.cluster)
+            continue;
+
+        /* read just the cached entry and check that it is still the one we want */
+        dd->entry_cluster = slot->entry_cluster;
+        dd->entry_offset = slot->entry_offset;
+        uint8_t found = fat_read_dir(dd, dir_entry) && strcmp(dir_entry->long_name, name) == 0;
+        fat_reset_dir(dd);
+        if(found)
+            return 1;
+
+        slot->name_hash = 0;
+        break;
+    }
+#endif
+
+    fat_reset_dir(dd);
+    while(1)
+    {
+#if FAT_DIR_CACHE_COUNT
+        cluster_t entry_cluster = dd->entry_cluster;
+        uint16_t entry_offset = dd->entry_offset;
+#endif
+        if(!fat_read_dir(dd, dir_entry))
+            return 0;
+
+        if(strcmp(dir_entry->long_name, name) == 0)
+        {
+#if FAT_DIR_CACHE_COUNT
+            slot = &fs->dir_cache[fs->dir_cache_next];
+            if(++fs->dir_cache_next >= FAT_DIR_CACHE_COUNT)
+                fs->dir_cache_next = 0;
+
+            slot->name_hash = name_hash;
+            slot->dir_cluster = dd->dir_entry.cluster;
+            slot->entry_cluster = entry_cluster;
+            slot->entry_offset = entry_offset;
+#endif
+            fat_reset_dir(dd);
+            return 1;
+        }
+    }
+}
+
+#if FAT_DIR_CACHE_COUNT
+/**
+ * \ingroup fat_dir
+ * Calculates the hash used to key the directory entry cache.
+ *
+ * \param[in] name The entry name.
+ * \returns The hash of the name, never 0.
+ */
+uint16_t fat_dir_cache_hash(const char* name)
+{
+    uint16_t hash = 0;
+    while(*name)
+        hash = hash * 31 + (uint8_t) *name++;
+
+    return hash ? hash : 1;
+}
+
+/**
+ * \ingroup fat_dir
+ * Forgets all cached directory entry positions.
+ *
+ * \param[in] fs The filesystem whose cache to clear.
+ */
+void fat_dir_cache_clear(struct fat_fs_struct* fs)
+{
+    for(uint8_t i = 0; i < FAT_DIR_CACHE_COUNT; ++i)
+        fs->dir_cache[i].name_hash = 0;
+}
+#endif
+
 /**
  * \ingroup fat_fs
  * Callback function for reading a directory entry.
@@ -2095,6 +2726,10 @@ uint8_t fat_create_file(struct fat_dir_struct* parent, const char* file, struct
     if(!fat_write_dir_entry(fs, dir_entry))
         return 0;
 
+#if FAT_DIR_CACHE_COUNT
+    fat_dir_cache_clear(fs);
+#endif
+
     return 1;
 }
 #endif
@@ -2124,6 +2759,10 @@ uint8_t fat_delete_file(struct fat_fs_struct* fs, struct fat_dir_entry_struct* d
     if(!dir_entry_offset)
         return 0;
 
+#if FAT_DIR_CACHE_COUNT
+    fat_dir_cache_clear(fs);
+#endif
+
 #if FAT_LFN_SUPPORT
     uint8_t buffer[12];
     while(1)
@@ -2312,6 +2951,10 @@ uint8_t fat_create_dir(struct fat_dir_struct* parent, const char* dir, struct fa
         return 0;
     }
 
+#if FAT_DIR_CACHE_COUNT
+    fat_dir_cache_clear(fs);
+#endif
+
     return 1;
 }
 #endif
@@ -2468,37 +3111,47 @@ offset_t fat_get_fs_size(const struct fat_fs_struct* fs)
  * \param[in] fs The filesystem on which to operate.
  * \returns 0 on failure, the free filesystem space in bytes otherwise.
  */
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
+offset_t fat_get_fs_free(struct fat_fs_struct* fs)
 {
     if(!fs)
         return 0;
 
+    /* the count is known from FSInfo or kept up to date since the last scan */
+    if(fs->cluster_free_count != FAT_CLUSTER_COUNT_UNKNOWN)
+        return (offset_t) fs->cluster_free_count * fs->header.cluster_size;
+
     uint8_t fat[32];
     struct fat_usage_count_callback_arg count_arg;
     count_arg.cluster_count = 0;
     count_arg.buffer_size = sizeof(fat);
 
+#if FAT_FAT32_SUPPORT
+    device_read_callback_t callback = fs->partition->type == PARTITION_TYPE_FAT16 ?
+                                          fat_get_fs_free_16_callback :
+                                          fat_get_fs_free_32_callback;
+#else
+    device_read_callback_t callback = fat_get_fs_free_16_callback;
+#endif
+
+    /* the interval read leaves out a last partial buffer, which is read on its own */
     offset_t fat_offset = fs->header.fat_offset;
     uint32_t fat_size = fs->header.fat_size;
+    uint8_t fat_tail = fat_size % sizeof(fat);
+    fat_size -= fat_tail;
     while(fat_size > 0)
     {
-        uintptr_t length = UINTPTR_MAX - 1;
+        /* whole buffers, the interval read drops a partial last one of each chunk */
+        uintptr_t length = (uintptr_t) (FAT_FREE_CHUNK) / sizeof(fat) * sizeof(fat);
         if(fat_size < length)
             length = fat_size;
 
-        if(!fs->partition->device_read_interval(fat_offset,
-                                                fat,
-                                                sizeof(fat),
-                                                length,
-#if FAT_FAT32_SUPPORT
-                                                (fs->partition->type == PARTITION_TYPE_FAT16) ?
-                                                    fat_get_fs_free_16_callback :
-                                                    fat_get_fs_free_32_callback,
-#else
-                                                fat_get_fs_free_16_callback,
-#endif
-                                                &count_arg
-                                               )
+        if(!fs->partition->device_read_interval_stream(fat_offset,
+                                                       fat,
+                                                       sizeof(fat),
+                                                       length,
+                                                       callback,
+                                                       &count_arg
+                                                      )
           )
             return 0;
 
@@ -2506,6 +3159,25 @@ offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
         fat_size -= length;
     }
 
+    if(fat_tail)
+    {
+        if(!fs->partition->device_read(fat_offset, fat, fat_tail))
+            return 0;
+
+        count_arg.buffer_size = fat_tail;
+        callback(fat, fat_offset, &count_arg);
+    }
+
+    /* entries 0 and 1 are reserved, no more data clusters than FAT entries can be free */
+#if FAT_FAT32_SUPPORT
+    cluster_t cluster_count = fs->header.fat_size / (fs->partition->type == PARTITION_TYPE_FAT16 ? 2 : 4) - 2;
+#else
+    cluster_t cluster_count = fs->header.fat_size / 2 - 2;
+#endif
+    if(count_arg.cluster_count > cluster_count)
+        count_arg.cluster_count = cluster_count;
+
+    fs->cluster_free_count = count_arg.cluster_count;
     return (offset_t) count_arg.cluster_count * fs->header.cluster_size;
 }
 
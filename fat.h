@@ -88,12 +88,23 @@ struct fat_dir_entry_struct
     offset_t entry_offset;
 };
 
+/**
+ * A function called by fat_read_file_interval() for each unit of data.
+ *
+ * \param[in] buffer The unit of data read from the file.
+ * \param[in] pos The file position of the unit.
+ * \param[in] p An opaque pointer.
+ * \returns 0 to stop reading, 1 to continue.
+ */
+typedef uint8_t (*fat_read_interval_handler_t)(uint8_t* buffer, offset_t pos, void* p);
+
 struct fat_fs_struct* fat_open(struct partition_struct* partition);
 void fat_close(struct fat_fs_struct* fs);
 
 struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat_dir_entry_struct* dir_entry);
 void fat_close_file(struct fat_file_struct* fd);
 intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t buffer_len);
+intptr_t fat_read_file_interval(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t interval, uintptr_t length, fat_read_interval_handler_t callback, void* p);
 intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintptr_t buffer_len);
 uint8_t fat_seek_file(struct fat_file_struct* fd, int32_t* offset, uint8_t whence);
 uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size);
@@ -102,6 +113,7 @@ struct fat_dir_struct* fat_open_dir(struct fat_fs_struct* fs, const struct fat_d
 void fat_close_dir(struct fat_dir_struct* dd);
 uint8_t fat_read_dir(struct fat_dir_struct* dd, struct fat_dir_entry_struct* dir_entry);
 uint8_t fat_reset_dir(struct fat_dir_struct* dd);
+uint8_t fat_find_dir_entry(struct fat_dir_struct* dd, const char* name, struct fat_dir_entry_struct* dir_entry);
 
 uint8_t fat_create_file(struct fat_dir_struct* parent, const char* file, struct fat_dir_entry_struct* dir_entry);
 uint8_t fat_delete_file(struct fat_fs_struct* fs, struct fat_dir_entry_struct* dir_entry);
@@ -116,7 +128,7 @@ void fat_get_file_modification_time(const struct fat_dir_entry_struct* dir_entry
 uint8_t fat_get_dir_entry_of_path(struct fat_fs_struct* fs, const char* path, struct fat_dir_entry_struct* dir_entry);
 
 offset_t fat_get_fs_size(const struct fat_fs_struct* fs);
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs);
+offset_t fat_get_fs_free(struct fat_fs_struct* fs);
 
 /**
  * @}
@@ -70,6 +70,52 @@ extern "C"
  */
 #define FAT_DELAY_DIRENTRY_UPDATE 0
 
+/**
+ * \ingroup fat_config
+ * Controls the cluster chain cache.
+ *
+ * Set to the number of contiguous cluster runs remembered for the
+ * most recently used cluster chain, or to 0 to disable the cache.
+ * Seeks within the cached part of a file need no FAT access.
+ */
+#ifndef FAT_EXTENT_COUNT
+#define FAT_EXTENT_COUNT 4
+#endif
+
+/**
+ * \ingroup fat_config
+ * Controls the directory entry lookup cache.
+ *
+ * Set to the number of file names whose directory position is
+ * remembered by fat_find_dir_entry(), or to 0 to disable the cache.
+ * A cached name is found by reading its entry alone instead of
+ * walking the directory.
+ */
+#ifndef FAT_DIR_CACHE_COUNT
+#define FAT_DIR_CACHE_COUNT 4
+#endif
+
+/**
+ * \ingroup fat_config
+ * Controls the free cluster window.
+ *
+ * Set to the number of clusters (a multiple of 8) whose free state is
+ * kept as a RAM bitmap for cluster allocation, or to 0 to read the FAT
+ * entry of each candidate cluster instead.
+ */
+#define FAT_FREE_WINDOW 256
+
+/**
+ * \ingroup fat_config
+ * Limits the FAT bytes counted by one interval read of fat_get_fs_free().
+ *
+ * The length is rounded down to a multiple of the read buffer. The
+ * default is the largest length a \c uintptr_t can hold.
+ */
+#ifndef FAT_FREE_CHUNK
+#define FAT_FREE_CHUNK (UINTPTR_MAX - 1)
+#endif
+
 /**
  * \ingroup fat_config
  * Determines the function used for retrieving current date and time.
@@ -0,0 +1,112 @@
+/*
+ * hal.h
+ *
+ * Created: 17.10.2026 14:05:12
+ */
+#pragma once
+
+//On the target this only pulls in avr-libc. Any other compiler gets
+//registers as plain variables (defined in host/hal_host.c), ISRs as ordinary
+//functions the simulation calls, and delays that advance a simulated clock.
+
+#include <stdint.h>
+
+#ifdef __AVR__
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include <util/atomic.h>
+
+#define hal_idle() do{}while(0)					//body of loops waiting for an interrupt
+
+#else
+
+#include <string.h>
+
+#ifndef __AVR_ATmega328P__
+#define __AVR_ATmega328P__
+#endif
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define HAL_REGS(R8, R16) \
+	R8(PINB) R8(DDRB) R8(PORTB) R8(PINC) R8(DDRC) R8(PORTC) R8(PIND) R8(DDRD) R8(PORTD) \
+	R8(TIFR0) R8(TIFR1) R8(TIFR2) R8(PCIFR) R8(EIFR) R8(EIMSK) R8(GPIOR0) R8(EECR) R8(TCCR0A) \
+	R8(TCCR0B) R8(TCNT0) R8(OCR0A) R8(OCR0B) R8(GTCCR) R8(SPCR) R8(ACSR) \
+	R8(SREG) R8(SMCR) R8(MCUSR) R8(MCUCR) R8(PCICR) R8(EICRA) R8(PCMSK0) R8(PCMSK1) \
+	R8(PCMSK2) R8(TIMSK0) R8(TIMSK1) R8(TIMSK2) R8(ADCL) R8(ADCH) R8(ADCSRA) R8(ADCSRB) \
+	R8(ADMUX) R8(DIDR0) R8(DIDR1) R8(TCCR1A) R8(TCCR1B) R8(TCCR1C) R8(TCCR2A) R8(TCCR2B) \
+	R8(TCNT2) R8(OCR2A) R8(OCR2B) R8(ASSR) R8(TWBR) R8(TWSR) R8(TWAR) R8(TWDR) R8(TWCR) \
+	R8(TWAMR) R8(UCSR0A) R8(UCSR0B) R8(UCSR0C) R8(UBRR0L) R8(UBRR0H) R8(UDR0) R16(ADC) \
+	R16(TCNT1) R16(ICR1) R16(OCR1A) R16(OCR1B)
+
+#define HAL_REG8(name) extern volatile uint8_t name;
+#define HAL_REG16(name) extern volatile uint16_t name;
+HAL_REGS(HAL_REG8, HAL_REG16)
+#undef HAL_REG8
+#undef HAL_REG16
+
+//a transfer starts on the first SPSR read after SPDR was touched, the byte
+//is exchanged with the SPI device of the simulation
+volatile uint8_t* hal_spdr(void);
+volatile uint8_t* hal_spsr(void);
+#define SPDR (*hal_spdr())
+#define SPSR (*hal_spsr())
+
+//avr-libc defines these as macros, uart.h tests for them
+#define UDR0 UDR0
+#define USART_RX_vect USART_RX_vect
+
+enum enum_hal_bits{
+	PB0=0,PB1,PB2,PB3,PB4,PB5,PB6,PB7,
+	PORTB0=0,PORTB1,PORTB2,PORTB3,PORTB4,PORTB5,PORTB6,PORTB7,
+	DDB0=0,DDB1,DDB2,DDB3,DDB4,DDB5,DDB6,DDB7,
+	PC0=0,PC1,PC2,PC3,PC4,PC5,PC6,
+	PINC0=0,PINC1,PINC2,PINC3,PINC4,PINC5,
+	DDC0=0,DDC1,DDC2,DDC3,DDC4,DDC5,
+	PD0=0,PD1,PD2,PD3,PD4,PD5,PD6,PD7,
+	TOV0=0,OCF0A,OCF0B, TOV1=0,OCF1A,OCF1B,ICF1=5, TOV2=0,OCF2A,OCF2B,
+	PCIF0=0,PCIF1,PCIF2, PCIE0=0,PCIE1,PCIE2,
+	PCINT8=0,PCINT9,PCINT10,PCINT11,PCINT12,PCINT13,PCINT14,
+	INT0=0,INT1, INTF0=0,INTF1, ISC00=0,ISC01,ISC10,ISC11,
+	TOIE0=0,OCIE0A,OCIE0B, TOIE1=0,OCIE1A,OCIE1B,ICIE1=5, TOIE2=0,OCIE2A,OCIE2B,
+	WGM00=0,WGM01,COM0B0=4,COM0B1,COM0A0,COM0A1, CS00=0,CS01,CS02,WGM02,
+	WGM10=0,WGM11,COM1B0=4,COM1B1,COM1A0,COM1A1, CS10=0,CS11,CS12,WGM12,WGM13,ICES1=6,ICNC1,
+	WGM20=0,WGM21,COM2B0=4,COM2B1,COM2A0,COM2A1, CS20=0,CS21,CS22,WGM22,
+	SPR0=0,SPR1,CPHA,CPOL,MSTR,DORD,SPE,SPIE, SPI2X=0,WCOL=6,SPIF=7,
+	ACIS0=0,ACIS1,ACIC,ACIE,ACI,ACO,ACBG,ACD,
+	ADPS0=0,ADPS1,ADPS2,ADIE,ADIF,ADATE,ADSC,ADEN,
+	ADTS0=0,ADTS1,ADTS2,ACME=6,
+	MUX0=0,MUX1,MUX2,MUX3,ADLAR=5,REFS0,REFS1,
+	ADC0D=0,ADC1D,ADC2D,ADC3D,ADC4D,ADC5D, AIN0D=0,AIN1D,
+	TWIE=0,TWEN=2,TWWC,TWSTO,TWSTA,TWEA,TWINT,
+	RXC0=7,TXC0=6,UDRE0=5,U2X0=1,RXCIE0=7,TXCIE0=6,UDRIE0=5,RXEN0=4,TXEN0=3,UCSZ00=1,UCSZ01=2,
+	SE=0,SM0,SM1,SM2
+};
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= ~0x80)
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 0
+#define ATOMIC_BLOCK(type) for(uint8_t hal_sreg = SREG, hal_atomic = (cli(), 1); hal_atomic; SREG = hal_sreg, hal_atomic = 0)
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+
+//simulated time in CPU cycles, timers, interrupts and device models are
+//stepped while it advances
+extern volatile uint64_t hal_cycles;
+void hal_advance(uint32_t cycles);
+void hal_idle(void);									//runs up to the next simulated event
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif // __AVR__
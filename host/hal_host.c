@@ -0,0 +1,296 @@
+/*
+ * hal_host.c
+ *
+ * Created: 17.10.2026 14:22:40
+ */
+#include "../hal.h"
+#include "sim.h"
+
+#define HAL_REG8(name) volatile uint8_t name;
+#define HAL_REG16(name) volatile uint16_t name;
+HAL_REGS(HAL_REG8, HAL_REG16)
+
+volatile uint64_t hal_cycles;
+
+uint8_t sim_pin_ext[SIM_PORTS];
+uint8_t sim_pin_low[SIM_PORTS];
+uint16_t (*sim_adc_input)(uint8_t channel);
+uint8_t (*sim_spi_exchange)(uint8_t data);
+uint64_t sim_deadline;
+void (*sim_deadline_hook)(void);
+
+static sim_model sim_models[SIM_MODELS];
+static uint8_t sim_model_count;
+static uint64_t sim_wake;
+
+static volatile uint8_t* const sim_port[SIM_PORTS] = {&PORTB, &PORTC, &PORTD};
+static volatile uint8_t* const sim_ddr[SIM_PORTS] = {&DDRB, &DDRC, &DDRD};
+static volatile uint8_t* const sim_in[SIM_PORTS] = {&PINB, &PINC, &PIND};
+
+//vectors the firmware may define, the rest are not simulated
+#define SIM_VECTORS(V) V(PCINT1_vect) V(TIMER2_OVF_vect) V(TIMER1_COMPA_vect) V(TIMER1_COMPB_vect) \
+	V(USART_RX_vect) V(ADC_vect)
+#define SIM_WEAK(name) extern void name(void) __attribute__((weak));
+SIM_VECTORS(SIM_WEAK)
+
+//interrupt flags are kept here, the flag registers only take write-1-to-clear.
+//Compare matches are only tracked while their interrupt is enabled.
+enum enum_sim_irq{SIM_IRQ_PCINT1, SIM_IRQ_T2_OVF, SIM_IRQ_T1_COMPA, SIM_IRQ_T1_COMPB, SIM_IRQ_RX, SIM_IRQ_ADC, SIM_IRQS};
+static uint8_t sim_flag[SIM_IRQS];
+
+static const uint16_t sim_t1_div[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+static const uint16_t sim_t2_div[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+static const uint8_t sim_adc_div[8] = {2, 2, 4, 8, 16, 32, 64, 128};
+static uint16_t sim_t1_frac, sim_t2_frac;
+static uint64_t sim_adc_done;
+static uint8_t sim_pinc_last;
+
+static volatile uint8_t sim_spdr, sim_spsr;
+static uint8_t sim_spi_armed, sim_spif_seen;
+
+void sim_reset(void)
+{
+#define HAL_ZERO(name) name = 0;
+	HAL_REGS(HAL_ZERO, HAL_ZERO)
+#undef HAL_ZERO
+	UCSR0A = 1<<UDRE0;
+	hal_cycles = 0;
+	for(uint8_t i=0;i<SIM_PORTS;i++){
+		sim_pin_ext[i] = 0xFF;
+		sim_pin_low[i] = 0;
+		*sim_in[i] = 0xFF;
+	}
+	sim_pinc_last = 0xFF;
+	sim_adc_input = 0;
+	sim_spi_exchange = 0;
+	sim_deadline = SIM_NEVER;
+	sim_deadline_hook = 0;
+	sim_model_count = 0;
+	sim_wake = SIM_NEVER;
+	memset(sim_flag, 0, sizeof(sim_flag));
+	sim_t1_frac = 0;
+	sim_t2_frac = 0;
+	sim_adc_done = SIM_NEVER;
+	sim_spdr = 0;
+	sim_spsr = 0;
+	sim_spi_armed = 0;
+	sim_spif_seen = 0;
+}
+
+void sim_attach(sim_model model)
+{
+	if(sim_model_count < SIM_MODELS) sim_models[sim_model_count++] = model;
+}
+
+uint8_t sim_pin_out_low(uint8_t port, uint8_t bit)
+{
+	return (*sim_ddr[port] & ~*sim_port[port] & (1<<bit)) != 0;
+}
+
+uint8_t sim_pin(uint8_t port, uint8_t bit)
+{
+	return (*sim_in[port] >> bit) & 0x01;
+}
+
+static uint32_t sim_t1_top(void)
+{
+	return (TCCR1B & (1<<WGM12)) ? OCR1A : 0xFFFF;
+}
+
+static uint32_t sim_t1_ticks_to(uint16_t value)		//timer ticks until TCNT1 becomes value, 0 - never
+{
+	uint32_t top = sim_t1_top(), span = top + 1, ticks;
+
+	if(TCNT1 > top) ticks = (uint16_t)(value - TCNT1);
+	else if(value > top) return 0;
+	else ticks = (value + span - TCNT1) % span;
+	return ticks ? ticks : span;
+}
+
+static uint64_t sim_next_event(void)
+{
+	uint64_t next = sim_wake;
+	uint16_t div = sim_t1_div[TCCR1B & 0x07];
+
+	if(div){
+		uint32_t a = TIMSK1 & (1<<OCIE1A) ? sim_t1_ticks_to(OCR1A) : 0;
+		uint32_t b = TIMSK1 & (1<<OCIE1B) ? sim_t1_ticks_to(OCR1B) : 0;
+		if(a && hal_cycles + (uint64_t)a * div - sim_t1_frac < next) next = hal_cycles + (uint64_t)a * div - sim_t1_frac;
+		if(b && hal_cycles + (uint64_t)b * div - sim_t1_frac < next) next = hal_cycles + (uint64_t)b * div - sim_t1_frac;
+	}
+	div = sim_t2_div[TCCR2B & 0x07];
+	if(div){
+		uint64_t t = hal_cycles + (uint64_t)(256 - TCNT2) * div - sim_t2_frac;
+		if(t < next) next = t;
+	}
+	if(sim_adc_done < next) next = sim_adc_done;
+	if(sim_deadline < next) next = sim_deadline;
+	return next;
+}
+
+static void sim_convert(void)
+{
+	uint8_t channel = ADMUX & 0x0F;
+	uint16_t value;
+
+	if(sim_adc_input) value = sim_adc_input(channel) & 0x3FF;
+	else value = channel < 6 && sim_pin(SIM_PORTC, channel) ? 0x3FF : 0;
+	if(ADMUX & (1<<ADLAR)){
+		ADCH = value >> 2;
+		ADCL = value << 6;
+	}else{
+		ADCH = value >> 8;
+		ADCL = value;
+	}
+	ADC = ADCH << 8 | ADCL;								//16 bit read gives the adjusted result too
+	sim_flag[SIM_IRQ_ADC] = 1;
+	if((ADCSRA & (1<<ADATE)) && (ADCSRB & 0x07) == 0) sim_adc_done += 13 * sim_adc_div[ADCSRA & 0x07];
+	else{
+		ADCSRA &= ~(1<<ADSC);
+		sim_adc_done = SIM_NEVER;
+	}
+}
+
+static void sim_step(uint64_t cycles)
+{
+	uint16_t div = sim_t1_div[TCCR1B & 0x07];
+
+	if(div){
+		uint32_t total = sim_t1_frac + cycles, ticks = total / div, top = sim_t1_top();
+		uint32_t a = TIMSK1 & (1<<OCIE1A) ? sim_t1_ticks_to(OCR1A) : 0;
+		uint32_t b = TIMSK1 & (1<<OCIE1B) ? sim_t1_ticks_to(OCR1B) : 0;
+		sim_t1_frac = total % div;
+		if(a && ticks >= a) sim_flag[SIM_IRQ_T1_COMPA] = 1;
+		if(b && ticks >= b) sim_flag[SIM_IRQ_T1_COMPB] = 1;
+		if(TCNT1 <= top) TCNT1 = (TCNT1 + ticks) % (top + 1);
+		else TCNT1 += ticks;
+	}
+	div = sim_t2_div[TCCR2B & 0x07];
+	if(div){
+		uint32_t total = sim_t2_frac + cycles, ticks = total / div;
+		sim_t2_frac = total % div;
+		if(ticks >= (uint32_t)(256 - TCNT2)) sim_flag[SIM_IRQ_T2_OVF] = 1;
+		TCNT2 += ticks;
+	}
+	hal_cycles += cycles;
+	if(hal_cycles >= sim_adc_done) sim_convert();
+}
+
+static uint8_t sim_enabled(uint8_t irq)
+{
+	switch(irq){
+		case SIM_IRQ_PCINT1: return PCICR & (1<<PCIE1);
+		case SIM_IRQ_T2_OVF: return TIMSK2 & (1<<TOIE2);
+		case SIM_IRQ_T1_COMPA: return TIMSK1 & (1<<OCIE1A);
+		case SIM_IRQ_T1_COMPB: return TIMSK1 & (1<<OCIE1B);
+		case SIM_IRQ_RX: return UCSR0B & (1<<RXCIE0);
+		case SIM_IRQ_ADC: return ADCSRA & (1<<ADIE);
+	}
+	return 0;
+}
+
+static void (*const sim_vector[SIM_IRQS])(void) = {
+#define SIM_ENTRY(name) name,
+	SIM_VECTORS(SIM_ENTRY)
+#undef SIM_ENTRY
+};
+
+//brings models, pins and flags up to date with what the firmware wrote and
+//runs the pending interrupts
+static void sim_sync(void)
+{
+	for(;;){
+		if(TIFR1 & (1<<OCF1A)) sim_flag[SIM_IRQ_T1_COMPA] = 0;
+		if(TIFR1 & (1<<OCF1B)) sim_flag[SIM_IRQ_T1_COMPB] = 0;
+		if(TIFR2 & (1<<TOV2)) sim_flag[SIM_IRQ_T2_OVF] = 0;
+		if(PCIFR & (1<<PCIF1)) sim_flag[SIM_IRQ_PCINT1] = 0;
+		if(ADCSRA & (1<<ADIF)) sim_flag[SIM_IRQ_ADC] = 0;
+		TIFR1 = 0;
+		TIFR2 = 0;
+		PCIFR = 0;
+		ADCSRA &= ~(1<<ADIF);
+		if(!(ADCSRA & (1<<ADEN))) sim_adc_done = SIM_NEVER;
+		else if((ADCSRA & (1<<ADSC)) && sim_adc_done == SIM_NEVER)
+			sim_adc_done = hal_cycles + 13 * sim_adc_div[ADCSRA & 0x07];
+
+		sim_wake = SIM_NEVER;
+		for(uint8_t i=0;i<sim_model_count;i++){
+			uint64_t wake = sim_models[i]();
+			if(wake < sim_wake) sim_wake = wake;
+		}
+		for(uint8_t i=0;i<SIM_PORTS;i++){
+			uint8_t ddr = *sim_ddr[i];
+			*sim_in[i] = ((*sim_port[i] & ddr) | (sim_pin_ext[i] & ~ddr)) & ~sim_pin_low[i];
+		}
+		if((PINC ^ sim_pinc_last) & PCMSK1) sim_flag[SIM_IRQ_PCINT1] = 1;
+		sim_pinc_last = PINC;
+
+		if(hal_cycles >= sim_deadline && sim_deadline_hook){
+			sim_deadline = SIM_NEVER;
+			sim_deadline_hook();
+		}
+
+		if(!(SREG & 0x80)) return;
+		uint8_t irq = 0;
+		while(irq < SIM_IRQS && !(sim_flag[irq] && sim_enabled(irq))) irq++;
+		if(irq == SIM_IRQS) return;
+		sim_flag[irq] = 0;
+		if(irq == SIM_IRQ_RX) continue;					//receive is not simulated
+		SREG &= ~0x80;
+		if(sim_vector[irq]) sim_vector[irq]();
+		SREG |= 0x80;
+	}
+}
+
+void hal_advance(uint32_t cycles)
+{
+	uint64_t end = hal_cycles + cycles;
+
+	for(;;){
+		sim_sync();
+		if(hal_cycles >= end) return;
+		uint64_t next = sim_next_event();
+		if(next > end) next = end;
+		sim_step(next - hal_cycles);
+	}
+}
+
+void hal_idle(void)
+{
+	uint64_t next = sim_next_event();
+
+	if(next <= hal_cycles) next = hal_cycles + 1;
+	if(next - hal_cycles > SIM_US(1000)) next = hal_cycles + SIM_US(1000);
+	hal_advance(next - hal_cycles);
+}
+
+void _delay_us(double us)
+{
+	hal_advance(SIM_US(us));
+}
+
+void _delay_ms(double ms)
+{
+	hal_advance(SIM_US(ms * 1000));
+}
+
+volatile uint8_t* hal_spdr(void)
+{
+	if(sim_spif_seen) sim_spsr &= ~(1<<SPIF);			//SPSR read with SPIF set, then SPDR accessed
+	sim_spif_seen = 0;
+	sim_spi_armed = 1;
+	return &sim_spdr;
+}
+
+volatile uint8_t* hal_spsr(void)
+{
+	if(sim_spi_armed && (SPCR & (1<<SPE))){
+		static const uint8_t div[4] = {4, 16, 64, 128};
+		sim_spi_armed = 0;
+		sim_spdr = sim_spi_exchange ? sim_spi_exchange(sim_spdr) : 0xFF;
+		hal_advance(8 * div[SPCR & 0x03] >> (sim_spsr & (1<<SPI2X) ? 1 : 0));
+		sim_spsr |= 1<<SPIF;
+	}
+	sim_spif_seen = sim_spsr & (1<<SPIF);
+	return &sim_spsr;
+}
@@ -0,0 +1,89 @@
+/*
+ * main_host.c
+ *
+ * Created: 17.10.2026 23:02:16
+ */
+//Runs the firmware of main.c (built with main renamed to firmware_main) in
+//the simulation for a given time.
+//key_copy_host [-t seconds] [-i card.img [-w]] [-d rom_hex]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "sd_card.h"
+#include "ow_device.h"
+
+int firmware_main(void);
+
+static jmp_buf host_stop;
+
+static void host_deadline(void)
+{
+	longjmp(host_stop, 1);
+}
+
+static uint8_t host_rom(const char* hex, uint8_t* rom)
+{
+	if(strlen(hex) != 16) return 0;
+	for(uint8_t i=0;i<8;i++){
+		unsigned int byte;
+		if(sscanf(hex + i * 2, "%2x", &byte) != 1) return 0;
+		rom[i] = byte;
+	}
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 5;
+	const char* image_name = 0;
+	uint8_t write_back = 0, rom[8], key = 0;
+	uint8_t* image = 0;
+	long size = 0;
+
+	for(int i=1;i<argc;i++){
+		if(!strcmp(argv[i], "-t") && i + 1 < argc) seconds = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-i") && i + 1 < argc) image_name = argv[++i];
+		else if(!strcmp(argv[i], "-w")) write_back = 1;
+		else if(!strcmp(argv[i], "-d") && i + 1 < argc && host_rom(argv[i + 1], rom)){key = 1; i++;}
+		else{
+			fprintf(stderr, "usage: %s [-t seconds] [-i card.img [-w]] [-d rom_hex]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	sim_reset();
+	if(image_name){
+		FILE* f = fopen(image_name, "rb");
+		if(!f){perror(image_name); return 1;}
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		image = malloc(size);
+		if(!image || fread(image, 1, size, f) != (size_t)size){fclose(f); fprintf(stderr, "%s: read error\n", image_name); return 1;}
+		fclose(f);
+		sd_card_attach(image, size / 512);
+	}
+	ow_bus_attach();
+	if(key) ow_device_add(rom, 30, 0);
+
+	sim_deadline = SIM_US(seconds * 1000000);
+	sim_deadline_hook = host_deadline;
+	if(!setjmp(host_stop)) firmware_main();
+
+	printf("simulated %.3f s\n", SIM_TIME_US(hal_cycles) / 1000000);
+	printf("1-Wire resets with presence: %u\n", ow_resets);
+	printf("SD card: %lu commands, %lu SPI bytes, %lu blocks read, %lu blocks written\n",
+		   (unsigned long)sd_card_stats.commands, (unsigned long)sd_card_stats.bytes,
+		   (unsigned long)sd_card_stats.blocks_read, (unsigned long)sd_card_stats.blocks_written);
+
+	if(image && write_back){
+		FILE* f = fopen(image_name, "wb");
+		if(!f || fwrite(image, 1, size, f) != (size_t)size){fprintf(stderr, "%s: write error\n", image_name); return 1;}
+		fclose(f);
+	}
+	free(image);
+	return 0;
+}
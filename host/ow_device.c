@@ -0,0 +1,189 @@
+/*
+ * ow_device.c
+ *
+ * Created: 17.10.2026 22:34:47
+ */
+#include <string.h>
+#include "sim.h"
+#include "ow_device.h"
+
+#define OW_LINE PC0
+
+enum enum_ow_state{OW_IDLE, OW_ROM_CMD, OW_SEND, OW_MATCH, OW_SEARCH};
+
+struct ow_device{
+	uint8_t present;
+	uint8_t rom[8];
+	uint8_t presence_us;								//delay of the presence pulse after reset
+	uint8_t can_od, od;
+	uint8_t state, cmd, bit, phase;
+	uint8_t od_next;									//switch to overdrive after the ROM command
+	uint64_t presence_at, presence_end;
+	uint64_t hold_end;									//end of a 0 bit sent by the device, shortest the spec allows
+	uint64_t sample_at;									//where the device samples the master slot
+};
+
+struct ow_pulse ow_log[OW_LOG];
+uint16_t ow_log_count;
+uint16_t ow_resets;
+
+static struct ow_device ow_dev[OW_DEVICES];
+static uint8_t ow_master_low;
+static uint64_t ow_fall;
+
+static uint8_t ow_rom_bit(struct ow_device* dev)
+{
+	return (dev->rom[dev->bit >> 3] >> (dev->bit & 0x07)) & 0x01;
+}
+
+static uint8_t ow_sending(struct ow_device* dev)		//bit the device puts on the line in this slot, 1 - none
+{
+	if(dev->state == OW_SEND) return ow_rom_bit(dev);
+	if(dev->state == OW_SEARCH && dev->phase == 0) return ow_rom_bit(dev);
+	if(dev->state == OW_SEARCH && dev->phase == 1) return !ow_rom_bit(dev);
+	return 1;
+}
+
+static void ow_command(struct ow_device* dev)
+{
+	dev->bit = 0;
+	dev->phase = 0;
+	switch(dev->cmd){
+		case 0x33: dev->state = OW_SEND; break;				//Read ROM
+		case 0x55: dev->state = OW_MATCH; break;			//Match ROM
+		case 0x69:											//Overdrive Match ROM
+		case 0x3C:											//Overdrive Skip ROM
+			dev->state = dev->cmd == 0x69 ? OW_MATCH : OW_IDLE;
+			if(!dev->can_od) dev->state = OW_IDLE;
+			else dev->od_next = 1;
+			break;
+		case 0xF0: dev->state = OW_SEARCH; break;
+		default: dev->state = OW_IDLE; break;				//Skip ROM and function commands are not modelled
+	}
+	if(dev->od_next && dev->state == OW_IDLE){
+		dev->od = 1;
+		dev->od_next = 0;
+	}
+}
+
+static void ow_receive(struct ow_device* dev, uint8_t value)	//master slot sampled
+{
+	switch(dev->state){
+		case OW_ROM_CMD:
+			dev->cmd = (dev->cmd >> 1) | (value ? 0x80 : 0);
+			if(++dev->bit == 8) ow_command(dev);
+			break;
+		case OW_SEND:
+			if(++dev->bit == 64) dev->state = OW_IDLE;
+			break;
+		case OW_MATCH:
+			if(value != ow_rom_bit(dev)){dev->state = OW_IDLE; dev->od_next = 0; break;}
+			if(++dev->bit == 64){
+				dev->state = OW_IDLE;
+				if(dev->od_next){dev->od = 1; dev->od_next = 0;}
+			}
+			break;
+		case OW_SEARCH:
+			if(dev->phase < 2){dev->phase++; break;}
+			dev->phase = 0;
+			if(value != ow_rom_bit(dev)) dev->state = OW_IDLE;
+			else if(++dev->bit == 64) dev->state = OW_IDLE;
+			break;
+	}
+}
+
+static void ow_reset(struct ow_device* dev, uint64_t release, uint64_t low)
+{
+	if(low >= SIM_US(480)) dev->od = 0;
+	else if(!dev->od || low < SIM_US(48)) return;
+	dev->state = OW_ROM_CMD;
+	dev->cmd = 0;
+	dev->bit = 0;
+	dev->od_next = 0;
+	dev->sample_at = SIM_NEVER;
+	dev->hold_end = 0;
+	dev->presence_at = release + (dev->od ? SIM_US(2) : SIM_US(dev->presence_us));
+	dev->presence_end = dev->presence_at + (dev->od ? SIM_US(16) : SIM_US(120));
+}
+
+static uint64_t ow_bus_model(void)
+{
+	uint64_t now = hal_cycles, wake = SIM_NEVER;
+	uint8_t low = sim_pin_out_low(SIM_PORTC, OW_LINE), pull = 0;
+
+	if(low && !ow_master_low){							//slot or reset starts
+		ow_fall = now;
+		for(uint8_t i=0;i<OW_DEVICES;i++){
+			struct ow_device* dev = &ow_dev[i];
+			if(!dev->present || dev->state == OW_IDLE || now < dev->presence_end) continue;
+			dev->sample_at = now + (dev->od ? SIM_US(3) : SIM_US(30));
+			if(ow_sending(dev) == 0) dev->hold_end = now + (dev->od ? SIM_US(2) : SIM_US(15));
+		}
+	}
+	if(!low && ow_master_low){
+		uint64_t length = now - ow_fall;
+		if(ow_log_count < OW_LOG){
+			ow_log[ow_log_count].fall = ow_fall;
+			ow_log[ow_log_count].low = length;
+			ow_log_count++;
+		}
+		if(length >= SIM_US(48)){
+			uint8_t reset = 0;
+			for(uint8_t i=0;i<OW_DEVICES;i++){
+				if(!ow_dev[i].present) continue;
+				ow_reset(&ow_dev[i], now, length);
+				if(ow_dev[i].presence_at > now) reset = 1;
+			}
+			ow_resets += reset;
+		}
+	}
+	ow_master_low = low;
+
+	for(uint8_t i=0;i<OW_DEVICES;i++){
+		struct ow_device* dev = &ow_dev[i];
+		if(!dev->present) continue;
+		if(now >= dev->sample_at){
+			dev->sample_at = SIM_NEVER;
+			ow_receive(dev, !low);
+		}
+		if(now >= dev->presence_at && now < dev->presence_end) pull = 1;
+		if(now < dev->hold_end) pull = 1;
+		if(dev->sample_at < wake) wake = dev->sample_at;
+		if(dev->presence_at > now && dev->presence_at < wake) wake = dev->presence_at;
+		if(dev->presence_end > now && dev->presence_end < wake) wake = dev->presence_end;
+		if(dev->hold_end > now && dev->hold_end < wake) wake = dev->hold_end;
+	}
+	if(pull) sim_pin_low[SIM_PORTC] |= 1<<OW_LINE;
+	else sim_pin_low[SIM_PORTC] &= ~(1<<OW_LINE);
+	return wake;
+}
+
+void ow_bus_attach(void)
+{
+	memset(ow_dev, 0, sizeof(ow_dev));
+	ow_log_count = 0;
+	ow_resets = 0;
+	ow_master_low = 0;
+	sim_attach(ow_bus_model);
+}
+
+uint8_t ow_device_add(const uint8_t* rom, uint8_t presence_us, uint8_t overdrive)
+{
+	for(uint8_t i=0;i<OW_DEVICES;i++){
+		struct ow_device* dev = &ow_dev[i];
+		if(dev->present) continue;
+		memset(dev, 0, sizeof(*dev));
+		dev->present = 1;
+		memcpy(dev->rom, rom, 8);
+		dev->presence_us = presence_us;
+		dev->can_od = overdrive;
+		dev->sample_at = SIM_NEVER;
+		return i;
+	}
+	return 0xFF;
+}
+
+void ow_device_remove(uint8_t device)
+{
+	if(device < OW_DEVICES) ow_dev[device].present = 0;
+}
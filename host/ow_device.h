@@ -0,0 +1,28 @@
+/*
+ * ow_device.h
+ *
+ * Created: 17.10.2026 22:31:09
+ */
+#pragma once
+
+//iButtons on the DS line (PC0): reset and presence, Read ROM, Match/Skip
+//ROM, Search ROM and Overdrive Skip ROM. Every low pulse of the master is
+//logged, so tests can check slot timing.
+
+#include <stdint.h>
+
+#define OW_DEVICES 4
+#define OW_LOG 512
+
+struct ow_pulse{
+	uint64_t fall;										//cycle the master pulled the line low
+	uint32_t low;										//cycles it held it
+};
+
+extern struct ow_pulse ow_log[OW_LOG];
+extern uint16_t ow_log_count;
+extern uint16_t ow_resets;
+
+void ow_bus_attach(void);
+uint8_t ow_device_add(const uint8_t* rom, uint8_t presence_us, uint8_t overdrive);
+void ow_device_remove(uint8_t device);
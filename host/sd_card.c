@@ -0,0 +1,181 @@
+/*
+ * sd_card.c
+ *
+ * Created: 17.10.2026 22:07:54
+ */
+#include <string.h>
+#include "sim.h"
+#include "sd_card.h"
+
+#define SD_CARD_QUEUE 1024								//a block with token, CRC and gap fits
+#define SD_CARD_CS PORTB2
+
+enum enum_sd_card_state{SD_CARD_CMD, SD_CARD_WRITE, SD_CARD_WRITE_MULTI};
+
+struct sd_card_stats sd_card_stats;
+
+static uint8_t* sd_card_image;
+static uint32_t sd_card_blocks;
+static uint8_t sd_card_out[SD_CARD_QUEUE];
+static uint16_t sd_card_head, sd_card_tail;
+static uint8_t sd_card_cmd[6], sd_card_cmd_len;
+static uint8_t sd_card_app, sd_card_init_polls, sd_card_state;
+static uint8_t sd_card_stream;
+static uint32_t sd_card_address;
+static int16_t sd_card_pos;								//-1 - waiting for the data token
+static uint8_t sd_card_data[514];
+
+static void sd_card_push(uint8_t data)
+{
+	sd_card_out[sd_card_tail++ % SD_CARD_QUEUE] = data;
+}
+
+static void sd_card_flush(void)
+{
+	sd_card_head = sd_card_tail;
+}
+
+static void sd_card_push_reg(const uint8_t* reg)		//CID/CSD as a 16 byte data block
+{
+	sd_card_push(0xFF);
+	sd_card_push(0xFE);
+	for(uint8_t i=0;i<16;i++) sd_card_push(reg[i]);
+	sd_card_push(0xFF);
+	sd_card_push(0xFF);
+}
+
+static void sd_card_push_block(void)
+{
+	sd_card_push(0xFF);
+	sd_card_push(0xFE);
+	for(uint16_t i=0;i<512;i++)
+		sd_card_push(sd_card_address < sd_card_blocks ? sd_card_image[sd_card_address * 512 + i] : 0);
+	sd_card_push(0xFF);
+	sd_card_push(0xFF);
+	sd_card_address++;
+	sd_card_stats.blocks_read++;
+}
+
+static void sd_card_command(void)
+{
+	uint8_t cmd = sd_card_cmd[0] & 0x3F, app = sd_card_app;
+	uint32_t arg = (uint32_t)sd_card_cmd[1] << 24 | (uint32_t)sd_card_cmd[2] << 16 | (uint32_t)sd_card_cmd[3] << 8 | sd_card_cmd[4];
+
+	sd_card_stats.commands++;
+	sd_card_app = 0;
+	if(cmd == 12){										//answers right after the command, even mid block
+		sd_card_flush();
+		sd_card_stream = 0;
+		sd_card_push(0xFF);
+		sd_card_push(0x00);
+		sd_card_push(0x00);
+		return;
+	}
+	sd_card_push(0xFF);
+	switch(cmd){
+		case 0: sd_card_push(0x01); sd_card_init_polls = 0; break;
+		case 8: sd_card_push(0x01); sd_card_push(0); sd_card_push(0); sd_card_push(0x01); sd_card_push(arg & 0xFF); break;
+		case 55: sd_card_app = 1; sd_card_push(sd_card_init_polls > 2 ? 0x00 : 0x01); break;
+		case 41:
+			if(!app){sd_card_push(0x04); break;}
+			sd_card_push(++sd_card_init_polls > 2 ? 0x00 : 0x01);
+			break;
+		case 58: sd_card_push(0x00); sd_card_push(0xC0); sd_card_push(0xFF); sd_card_push(0x80); sd_card_push(0x00); break;
+		case 9:{
+			uint32_t size = sd_card_blocks / 1024 - 1;
+			uint8_t csd[16] = {0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, (size >> 16) & 0x3F, size >> 8, size,
+							   0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01};
+			sd_card_push(0x00);
+			sd_card_push_reg(csd);
+			break;
+		}
+		case 10:{
+			static const uint8_t cid[16] = {0x03, 'S', 'D', 'H', 'O', 'S', 'T', ' ', 0x10, 0x12, 0x34, 0x56, 0x78, 0x01, 0xAA, 0x01};
+			sd_card_push(0x00);
+			sd_card_push_reg(cid);
+			break;
+		}
+		case 13: sd_card_push(0x00); sd_card_push(0x00); break;
+		case 16: case 23: sd_card_push(0x00); break;
+		case 17: case 18:
+			sd_card_push(0x00);
+			sd_card_address = arg;
+			sd_card_stream = cmd == 18;
+			sd_card_push_block();
+			break;
+		case 24: case 25:
+			sd_card_push(0x00);
+			sd_card_state = cmd == 24 ? SD_CARD_WRITE : SD_CARD_WRITE_MULTI;
+			sd_card_address = arg;
+			sd_card_pos = -1;
+			break;
+		default: sd_card_push(0x04); break;					//illegal command
+	}
+}
+
+static uint8_t sd_card_write(uint8_t data)
+{
+	if(sd_card_pos < 0){
+		if(data == 0xFE && sd_card_state == SD_CARD_WRITE) sd_card_pos = 0;
+		if(data == 0xFC && sd_card_state == SD_CARD_WRITE_MULTI) sd_card_pos = 0;
+		if(data == 0xFD && sd_card_state == SD_CARD_WRITE_MULTI){	//stop token, a busy byte follows
+			sd_card_state = SD_CARD_CMD;
+			sd_card_flush();
+			sd_card_push(0xFF);
+			sd_card_push(0x00);
+			return 0xFF;
+		}
+		return sd_card_head != sd_card_tail ? sd_card_out[sd_card_head++ % SD_CARD_QUEUE] : 0xFF;
+	}
+	sd_card_data[sd_card_pos++] = data;
+	if(sd_card_pos == sizeof(sd_card_data)){			//block and CRC received
+		if(sd_card_address < sd_card_blocks) memcpy(sd_card_image + sd_card_address * 512, sd_card_data, 512);
+		sd_card_stats.blocks_written++;
+		sd_card_flush();
+		sd_card_push(0xE5);								//data accepted
+		sd_card_push(0x00);								//busy
+		if(sd_card_state == SD_CARD_WRITE) sd_card_state = SD_CARD_CMD;
+		else{
+			sd_card_address++;
+			sd_card_pos = -1;
+		}
+	}
+	return 0xFF;
+}
+
+static uint8_t sd_card_exchange(uint8_t data)
+{
+	uint8_t answer = 0xFF;
+
+	if(!sim_pin_out_low(SIM_PORTB, SD_CARD_CS)) return 0xFF;
+	sd_card_stats.bytes++;
+	if(sd_card_state != SD_CARD_CMD) return sd_card_write(data);
+	if(sd_card_head != sd_card_tail) answer = sd_card_out[sd_card_head++ % SD_CARD_QUEUE];
+	else if(sd_card_stream && data == 0xFF){
+		sd_card_push_block();
+		answer = sd_card_out[sd_card_head++ % SD_CARD_QUEUE];
+	}
+	if(sd_card_cmd_len == 0 && (data & 0xC0) == 0x40) sd_card_cmd[sd_card_cmd_len++] = data;
+	else if(sd_card_cmd_len){
+		sd_card_cmd[sd_card_cmd_len++] = data;
+		if(sd_card_cmd_len == 6){
+			sd_card_cmd_len = 0;
+			sd_card_command();
+		}
+	}
+	return answer;
+}
+
+void sd_card_attach(uint8_t* image, uint32_t blocks)
+{
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	sd_card_image = image;
+	sd_card_blocks = blocks;
+	sd_card_head = sd_card_tail = 0;
+	sd_card_cmd_len = 0;
+	sd_card_app = 0;
+	sd_card_init_polls = 0;
+	sd_card_state = SD_CARD_CMD;
+	sd_card_stream = 0;
+	sim_spi_exchange = sd_card_exchange;
+}
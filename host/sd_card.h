@@ -0,0 +1,22 @@
+/*
+ * sd_card.h
+ *
+ * Created: 17.10.2026 22:05:31
+ */
+#pragma once
+
+//SDHC card in SPI mode on the SPI pins of the board, backed by an image in
+//memory. Selected while PB2 is driven low.
+
+#include <stdint.h>
+
+struct sd_card_stats{
+	uint32_t bytes;										//SPI bytes exchanged with the card selected
+	uint32_t commands;
+	uint32_t blocks_read;
+	uint32_t blocks_written;
+};
+
+extern struct sd_card_stats sd_card_stats;
+
+void sd_card_attach(uint8_t* image, uint32_t blocks);
@@ -0,0 +1,44 @@
+/*
+ * sim.h
+ *
+ * Created: 17.10.2026 21:40:18
+ */
+#pragma once
+
+//Peripheral simulation behind hal.h on the host. Timer1 (normal and CTC
+//mode), Timer2 overflow, the pin change interrupt of port C and the free
+//running ADC are modelled cycle exact, their interrupts are dispatched in
+//the AVR priority order while the I flag is set. Devices on the pins are
+//models called at every step of the clock.
+
+#include "../hal.h"
+
+#define SIM_NEVER UINT64_MAX
+#define SIM_US(us) ((uint64_t)((us) * (F_CPU / 1000000.0) + 0.5))
+#define SIM_TIME_US(cycles) ((double)(cycles) / (F_CPU / 1000000.0))
+
+enum enum_sim_port{SIM_PORTB, SIM_PORTC, SIM_PORTD, SIM_PORTS};
+
+//level of undriven input pins, 1 by default as the board pulls them up
+extern uint8_t sim_pin_ext[SIM_PORTS];
+//pins pulled low by an open drain device, wins over every other driver
+extern uint8_t sim_pin_low[SIM_PORTS];
+
+//a model sees the outputs and sets sim_pin_low/sim_pin_ext, it returns the
+//cycle it has to run next at (SIM_NEVER if only output changes matter)
+typedef uint64_t (*sim_model)(void);
+#define SIM_MODELS 4
+
+//10 bit conversion result of an ADC channel, by default the pin level
+extern uint16_t (*sim_adc_input)(uint8_t channel);
+//byte the SPI device answers while data is shifted out, 0xFF by default
+extern uint8_t (*sim_spi_exchange)(uint8_t data);
+
+//stop point of a run, the hook must not return (longjmp or exit)
+extern uint64_t sim_deadline;
+extern void (*sim_deadline_hook)(void);
+
+void sim_reset(void);
+void sim_attach(sim_model model);
+uint8_t sim_pin_out_low(uint8_t port, uint8_t bit);		//pin driven low by the MCU
+uint8_t sim_pin(uint8_t port, uint8_t bit);				//resulting line level
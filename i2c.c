@@ -1,5 +1,4 @@
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "i2c.h"
 
 /*************************************************************************
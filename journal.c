@@ -0,0 +1,59 @@
+/*
+ * journal.c
+ *
+ * Created: 17.10.2026 18:12:04
+ */
+#include <stdint.h>
+#include <string.h>
+#include "fat.h"
+#include "dallas.h"
+#include "journal.h"
+
+static uint8_t journal_get(struct fat_file_struct* fd, uint32_t n, uint8_t* buf)	//1 -  
+{
+	int32_t pos = n * JOURNAL_RECORD_SIZE;
+	
+	if(!fat_seek_file(fd, &pos, FAT_SEEK_SET)) return 0;
+	if(fat_read_file(fd, buf, JOURNAL_RECORD_SIZE) != JOURNAL_RECORD_SIZE) return 0;
+	return buf[0] == JOURNAL_MARK && ds_crc_block(buf, JOURNAL_RECORD_SIZE-1) == buf[JOURNAL_RECORD_SIZE-1];
+}
+
+uint32_t journal_open(struct fat_file_struct* fd)		// ,   
+{
+	uint8_t buf[JOURNAL_RECORD_SIZE];
+	int32_t size = 0;
+	
+	if(!fd || !fat_seek_file(fd, &size, FAT_SEEK_END)) return 0;
+	uint32_t count = size / JOURNAL_RECORD_SIZE;
+	if(count && !journal_get(fd, count-1, buf)) count--;
+	if(count * JOURNAL_RECORD_SIZE != (uint32_t)size) fat_resize_file(fd, count * JOURNAL_RECORD_SIZE);
+	size = 0;
+	fat_seek_file(fd, &size, FAT_SEEK_END);
+	return count;
+}
+
+uint8_t journal_read(struct fat_file_struct* fd, uint32_t n, struct journal_record_struct* record)
+{
+	uint8_t buf[JOURNAL_RECORD_SIZE];
+	
+	if(!journal_get(fd, n, buf)) return 0;
+	record->key = buf[1];
+	memcpy(record->code, buf+2, 8);
+	record->count = buf[10] | buf[11] << 8;
+	if(record->count == 0) record->count = 1;
+	return 1;
+}
+
+uint8_t journal_append(struct fat_file_struct* fd, struct journal_record_struct* record)	//  ,  journal_open()   
+{
+	uint8_t buf[JOURNAL_RECORD_SIZE];
+	
+	memset(buf, 0, sizeof(buf));
+	buf[0] = JOURNAL_MARK;
+	buf[1] = record->key;
+	memcpy(buf+2, record->code, 8);
+	buf[10] = record->count;
+	buf[11] = record->count >> 8;
+	buf[JOURNAL_RECORD_SIZE-1] = ds_crc_block(buf, JOURNAL_RECORD_SIZE-1);
+	return fat_write_file(fd, buf, sizeof(buf)) == sizeof(buf);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+/*
+ * journal.h
+ *
+ * Created: 17.10.2026 18:05:31
+ */
+#pragma once
+
+#include <stdint.h>
+#include "fat.h"
+
+//  log.bin -   ,  .
+//      (512  JOURNAL_RECORD_SIZE):
+//  0      JOURNAL_MARK
+//  1          enum_key
+//  2..9      out_data
+//  10..11    (  ), 0    -  
+//  12..14 , 
+//  15     CRC Dallas  0..14
+//  -   / JOURNAL_RECORD_SIZE,  CSV  tools/log2csv.c
+#define JOURNAL_RECORD_SIZE 16
+#define JOURNAL_MARK 0xA5
+
+struct journal_record_struct
+{
+	uint8_t key;
+	uint8_t code[8];
+	uint16_t count;										//  , 1   
+};
+
+uint32_t journal_open(struct fat_file_struct* fd);
+uint8_t journal_read(struct fat_file_struct* fd, uint32_t n, struct journal_record_struct* record);
+uint8_t journal_append(struct fat_file_struct* fd, struct journal_record_struct* record);
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*
+ * keydb.c
+ *
+ * Created: 17.10.2026 16:18:52
+ */
+#include <stdint.h>
+#include <string.h>
+#include "byteordering.h"
+#include "fat.h"
+#include "keydb.h"
+
+static uint8_t keydb_get(struct fat_file_struct* fd, uint32_t offset, uint8_t* buf, uint8_t len)
+{
+	int32_t pos = offset;
+	
+	if(!fat_seek_file(fd, &pos, FAT_SEEK_SET)) return 0;
+	return fat_read_file(fd, buf, len) == len;
+}
+
+static uint32_t keydb_index_offset(struct keydb_struct* db)
+{
+	return KEYDB_HEADER_SIZE + (uint32_t)db->records * KEYDB_RECORD_SIZE;
+}
+
+uint8_t keydb_open(struct fat_file_struct* fd, struct keydb_struct* db)	//1 -  
+{
+	uint8_t header[8];
+	
+	if(!fd || !keydb_get(fd, 0, header, sizeof(header))) return 0;
+	if(header[0] != 'K' || header[1] != 'D' || header[2] != 'B' || header[3] != '1') return 0;
+	db->records = read16(header+4);
+	db->locations = read16(header+6);
+	return 1;
+}
+
+uint8_t keydb_read(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t n, struct keydb_record_struct* record)
+{
+	uint8_t buf[KEYDB_RECORD_SIZE];
+	
+	if(n >= db->records) return 0;
+	if(!keydb_get(fd, KEYDB_HEADER_SIZE + (uint32_t)n * KEYDB_RECORD_SIZE, buf, sizeof(buf))) return 0;
+	memcpy(record->code, buf, 8);
+	record->type = buf[8];
+	record->location = read16(buf+10);
+	return 1;
+}
+
+uint16_t keydb_find(struct fat_file_struct* fd, struct keydb_struct* db, const uint8_t* code, struct keydb_record_struct* record)
+{
+	uint16_t low = 0, high = db->records;
+	
+	while(low < high){									//   
+		uint16_t mid = low + (high - low) / 2;
+		if(!keydb_read(fd, db, mid, record)) return KEYDB_NONE;
+		int cmp = memcmp(record->code, code, 8);
+		if(cmp == 0) return mid;
+		if(cmp < 0) low = mid + 1;
+		else high = mid;
+	}
+	return KEYDB_NONE;
+}
+
+uint8_t keydb_read_sorted(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t pos, struct keydb_record_struct* record)	//pos -     
+{
+	uint8_t buf[2];
+	
+	if(pos >= db->records) return 0;
+	if(!keydb_get(fd, keydb_index_offset(db) + pos * 2UL, buf, sizeof(buf))) return 0;
+	return keydb_read(fd, db, read16(buf), record);
+}
+
+uint16_t keydb_location_first(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t location)	//        location
+{
+	struct keydb_record_struct record;
+	uint16_t low = 0, high = db->records;
+	
+	while(low < high){
+		uint16_t mid = low + (high - low) / 2;
+		if(!keydb_read_sorted(fd, db, mid, &record)) return db->records;
+		if(record.location < location) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+uint8_t keydb_location(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t location, char* buf)	//buf  KEYDB_LOCATION_SIZE 
+{
+	uint32_t offset = keydb_index_offset(db) + db->records * 2UL + (uint32_t)location * KEYDB_LOCATION_SIZE;
+	
+	if(location >= db->locations) return 0;
+	if(!keydb_get(fd, offset, (uint8_t*)buf, KEYDB_LOCATION_SIZE)) return 0;
+	buf[KEYDB_LOCATION_SIZE-1] = 0;
+	return 1;
+}
\ No newline at end of file
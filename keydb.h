@@ -0,0 +1,40 @@
+/*
+ * keydb.h
+ *
+ * Created: 17.10.2026 16:10:25
+ */
+#pragma once
+
+#include <stdint.h>
+#include "fat.h"
+
+//   keys.kdb,   keys.csv  tools/keys2kdb.c.
+//  little-endian.
+//     KEYDB_HEADER_SIZE : "KDB1",  ,  
+//        KEYDB_RECORD_SIZE ,   
+//          (uint16_t),   
+//        KEYDB_LOCATION_SIZE ,    keys.csv,   
+#define KEYDB_HEADER_SIZE 16
+#define KEYDB_RECORD_SIZE 12
+#define KEYDB_LOCATION_SIZE 32
+#define KEYDB_NONE 0xFFFF
+
+struct keydb_struct
+{
+	uint16_t records;
+	uint16_t locations;
+};
+
+struct keydb_record_struct
+{
+	uint8_t code[8];									//  out_data
+	uint8_t type;										//   enum_key
+	uint16_t location;
+};
+
+uint8_t keydb_open(struct fat_file_struct* fd, struct keydb_struct* db);
+uint16_t keydb_find(struct fat_file_struct* fd, struct keydb_struct* db, const uint8_t* code, struct keydb_record_struct* record);
+uint8_t keydb_read(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t n, struct keydb_record_struct* record);
+uint8_t keydb_read_sorted(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t pos, struct keydb_record_struct* record);
+uint16_t keydb_location_first(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t location);
+uint8_t keydb_location(struct fat_file_struct* fd, struct keydb_struct* db, uint16_t location, char* buf);
\ No newline at end of file
@@ -4,8 +4,7 @@
  * Created: 28.01.2016 0:09:48
  *  Author: Elektron
  */ 
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "kt-01.h"
 
 void kt_init()
@@ -18,6 +17,31 @@ void kt_init()
 	
 }
 
+#if KT_CRC_TABLE == KT_CRC_FULL
+static const uint8_t kt_crc_tbl[256] PROGMEM = {
+	0x00, 0x0B, 0x01, 0x0A, 0x02, 0x09, 0x03, 0x08, 0x04, 0x0F, 0x05, 0x0E, 0x06, 0x0D, 0x07, 0x0C,
+	0x08, 0x03, 0x09, 0x02, 0x0A, 0x01, 0x0B, 0x00, 0x0C, 0x07, 0x0D, 0x06, 0x0E, 0x05, 0x0F, 0x04,
+	0x07, 0x0C, 0x06, 0x0D, 0x05, 0x0E, 0x04, 0x0F, 0x03, 0x08, 0x02, 0x09, 0x01, 0x0A, 0x00, 0x0B,
+	0x0F, 0x04, 0x0E, 0x05, 0x0D, 0x06, 0x0C, 0x07, 0x0B, 0x00, 0x0A, 0x01, 0x09, 0x02, 0x08, 0x03,
+	0x0E, 0x05, 0x0F, 0x04, 0x0C, 0x07, 0x0D, 0x06, 0x0A, 0x01, 0x0B, 0x00, 0x08, 0x03, 0x09, 0x02,
+	0x06, 0x0D, 0x07, 0x0C, 0x04, 0x0F, 0x05, 0x0E, 0x02, 0x09, 0x03, 0x08, 0x00, 0x0B, 0x01, 0x0A,
+	0x09, 0x02, 0x08, 0x03, 0x0B, 0x00, 0x0A, 0x01, 0x0D, 0x06, 0x0C, 0x07, 0x0F, 0x04, 0x0E, 0x05,
+	0x01, 0x0A, 0x00, 0x0B, 0x03, 0x08, 0x02, 0x09, 0x05, 0x0E, 0x04, 0x0F, 0x07, 0x0C, 0x06, 0x0D,
+	0x0B, 0x00, 0x0A, 0x01, 0x09, 0x02, 0x08, 0x03, 0x0F, 0x04, 0x0E, 0x05, 0x0D, 0x06, 0x0C, 0x07,
+	0x03, 0x08, 0x02, 0x09, 0x01, 0x0A, 0x00, 0x0B, 0x07, 0x0C, 0x06, 0x0D, 0x05, 0x0E, 0x04, 0x0F,
+	0x0C, 0x07, 0x0D, 0x06, 0x0E, 0x05, 0x0F, 0x04, 0x08, 0x03, 0x09, 0x02, 0x0A, 0x01, 0x0B, 0x00,
+	0x04, 0x0F, 0x05, 0x0E, 0x06, 0x0D, 0x07, 0x0C, 0x00, 0x0B, 0x01, 0x0A, 0x02, 0x09, 0x03, 0x08,
+	0x05, 0x0E, 0x04, 0x0F, 0x07, 0x0C, 0x06, 0x0D, 0x01, 0x0A, 0x00, 0x0B, 0x03, 0x08, 0x02, 0x09,
+	0x0D, 0x06, 0x0C, 0x07, 0x0F, 0x04, 0x0E, 0x05, 0x09, 0x02, 0x08, 0x03, 0x0B, 0x00, 0x0A, 0x01,
+	0x02, 0x09, 0x03, 0x08, 0x00, 0x0B, 0x01, 0x0A, 0x06, 0x0D, 0x07, 0x0C, 0x04, 0x0F, 0x05, 0x0E,
+	0x0A, 0x01, 0x0B, 0x00, 0x08, 0x03, 0x09, 0x02, 0x0E, 0x05, 0x0F, 0x04, 0x0C, 0x07, 0x0D, 0x06
+};
+#elif KT_CRC_TABLE == KT_CRC_NIBBLE
+static const uint8_t kt_crc_tbl[16] PROGMEM = {
+	0x00, 0x08, 0x07, 0x0F, 0x0E, 0x06, 0x09, 0x01, 0x0B, 0x03, 0x0C, 0x04, 0x05, 0x0D, 0x02, 0x0A
+};
+#endif
+
 uint8_t kt_crc(uint8_t* data, uint8_t len)
 {
 	uint8_t crc = 0;
@@ -25,12 +49,19 @@ uint8_t kt_crc(uint8_t* data, uint8_t len)
 	while (len--)
 	{
 		crc ^= *data++;
+#if KT_CRC_TABLE == KT_CRC_FULL
+		crc = pgm_read_byte(&kt_crc_tbl[crc]);
+#elif KT_CRC_TABLE == KT_CRC_NIBBLE
+		crc = (crc >> 4) ^ pgm_read_byte(&kt_crc_tbl[crc & 0x0F]);
+		crc = (crc >> 4) ^ pgm_read_byte(&kt_crc_tbl[crc & 0x0F]);
+#else
 		for (uint8_t i=0; i<8; i++){
 			if (crc & 0x01)
 			crc = (crc >> 1) ^ 0x0B;
 			else
 			crc >>= 1;
 		}
+#endif
 	}
 
 	return crc;
@@ -12,6 +12,14 @@
 #define KT_LINE 0
 #define KT_PROG 1
 
+//CRC variant: bitwise, 16-byte nibble table or 256-byte table in flash
+#define KT_CRC_BITWISE 0
+#define KT_CRC_NIBBLE 1
+#define KT_CRC_FULL 2
+#ifndef KT_CRC_TABLE
+#define KT_CRC_TABLE KT_CRC_NIBBLE
+#endif
+
 enum enum_kt{KT_READ_ROM_OK, KT_NO_KEY, KT_CRC_ERR};
 
 void kt_init(void);
@@ -9,10 +9,7 @@
 ** Quantum Torque - www.quantumtorque.com
 */
 #include <stdio.h>
-#include <avr/io.h>
-#include <avr/pgmspace.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "lcd.h"
 #include "lcd_graph.h"
 
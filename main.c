@@ -1,11 +1,9 @@
-#include <avr/io.h>
+#include "hal.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
-#include <avr/interrupt.h>
 #include "sound.h"
+#include "adc.h"
 #include "lcd.h"
 #include "dallas.h"
 #include "rfid.h"
@@ -16,6 +14,8 @@
 #include "sd_raw.h"
 #include "partition.h"
 #include "fat.h"
+#include "keydb.h"
+#include "journal.h"
 //     UART
 //#define UART
 
@@ -26,18 +26,36 @@
 //     30704 
 #define FILE_BUF_SIZE    64UL
 
+#define LOG_RING_SIZE    8								// ,     ( )
+#define LOG_FLUSH_COUNT  4								//    
+#define LOG_IDLE_TICKS   1300							//  ~20   
+#define BAT_LOW_MV       3400							//,      
+#define BAT_CHECK_TICKS  650								//~10       
+
+#define LIST_BACK_SIZE   16								//   keys.csv   
+#define TICK_US          16384							// Timer2, 256 * 1024 / 16 
+#define BROWSE_BACK_TICKS 25							//  400      -  
+#define BATCH_POLLS      3								//     
+#define BATCH_POLL_MS    10
+#define TICKS_PER_MIN    (60000000UL / TICK_US)
+
 #define BUTTON_PORT PORTB
 #define BUTTON_PIN  PINB
 #define BUTTON_DDR  DDRB
 #define BUTTON_LINE 0
 
-enum enum_key{KEY_NO_KEY, KEY_DALLAS, KEY_RFID, KEY_KT01, KEY_METAKOM, KEY_MK_DAL_1, KEY_MK_DAL_2, KEY_CYFRAL, KEY_CY_DAL_1, KEY_CY_DAL_2, KEY_RESIST};
+#define LINE_IDLE  0xFE									// ADC0    
+#define LINE_SWING 8									//,     
+
+enum enum_key{KEY_NO_KEY, KEY_DALLAS, KEY_RFID, KEY_KT01, KEY_METAKOM, KEY_MK_DAL_1, KEY_MK_DAL_2, KEY_CYFRAL, KEY_CY_DAL_1, KEY_CY_DAL_2, KEY_RESIST, KEY_MULTI};
 enum enum_tag{TAG_RW1990, TAG_TM08, TAG_TM2004, TAG_T5557, TAG_KT01, TAG_AUTO, TAG_DEFAULT};
-enum enum_mode{MODE_DEFAULT, MODE_MENU, MODE_WRITE, MODE_READ, MODE_LIST, MODE_RAND_DALLAS, MODE_RAND_PROXY, MODE_LOG, MODE_CLEAR, MODE_TO_PAGE_2,\
+enum enum_mode{MODE_DEFAULT, MODE_MENU, MODE_WRITE, MODE_READ, MODE_BATCH, MODE_LIST, MODE_RAND_DALLAS, MODE_RAND_PROXY, MODE_LOG, MODE_CLEAR, MODE_TO_PAGE_2,\
 			   MODE_EEPROM_24C16, MODE_24C16_TO_FILE, MODE_EEPROM_24C64, MODE_24C64_TO_FILE, MODE_END};
-enum enum_button{BUTTON_OFF, BUTTON_ON, BUTTON_HOLD};
+enum enum_button{BUTTON_OFF, BUTTON_ON, BUTTON_HOLD, BUTTON_BACK};
 enum enum_res{RES_READ_OK, RES_NO_PRES};
 enum enum_user{USER_DEFAULT, USER_CMD};
+enum enum_probe{PROBE_DALLAS, PROBE_MK_CL, PROBE_RESIST, PROBE_END};
+enum enum_batch{BATCH_COPIED, BATCH_SKIPPED, BATCH_ERROR, BATCH_LOST};
 
 const uint8_t sound_read[] PROGMEM = {C2+T1,D2+T1,E2+T1,F2+T1,G2+T1,MUTE};
 const uint8_t sound_write[] PROGMEM = {G2+T1,F2+T1,E2+T1,D2+T1,C2+T1,MUTE};
@@ -56,13 +74,30 @@ volatile uint8_t button = BUTTON_OFF;
 uint8_t mode = MODE_READ;
 uint8_t mode_loop = MODE_WRITE;
 uint8_t key = KEY_NO_KEY;
+uint8_t probe_order[PROBE_END] = {PROBE_DALLAS, PROBE_MK_CL, PROBE_RESIST};
+uint8_t probe_slot;
+uint8_t line_avg;
+uint8_t line_swing;
 uint8_t in_data[8];
 uint8_t out_data[8];
 char	file_buf[FILE_BUF_SIZE];
 int32_t file_seek;
 uint32_t file_size;
+uint16_t list_pos;
+int32_t list_back[LIST_BACK_SIZE];
+uint8_t list_back_pos;
+uint8_t list_back_count;
+struct keydb_struct list_db;
+uint32_t log_pos;
+uint32_t log_count;
+struct journal_record_struct log_ring[LOG_RING_SIZE];
+uint8_t log_head;
+uint8_t log_tail;
+volatile uint16_t log_idle;
+volatile uint16_t ticks;								// Timer2,  TICK_US
 static char keys[] = "keys.csv";
-static char logs[] = "log.csv";
+static char keydb[] = "keys.kdb";
+static char logs[] = "log.bin";
 static char eeprom[] = "eeprom___.bin";
 //static char eename[16];
 struct partition_struct* partition;
@@ -72,18 +107,24 @@ struct fat_dir_struct* dd;
 struct fat_file_struct* fd;
 void (*reset)() = 0;
 
+volatile uint8_t bat_low;								// ,     
+uint16_t bat_ticks;									//  
+
 uint16_t test_bat()
 {
 	ADMUX = (1 << REFS1)|(1 << REFS0) 					//   1,1v
 	|(1 << ADLAR)										//   (  1,  8   ADCH)
 	|(6); 											    //  ADC6
 	_delay_ms(1);
-	return ADCH*162;
+	uint16_t u = ADCH*162;
+	bat_low = u >= 600 && u < BAT_LOW_MV;					// 600 -   USB
+	return u;
 }
 
 ISR(TIMER2_OVF_vect)									// 
 {
 	static uint8_t button_state = 0;
+	static uint8_t click_ticks = 0xFF;					//   
 	static uint16_t timer = 0;
 	
 	#ifdef UART
@@ -96,18 +137,23 @@ ISR(TIMER2_OVF_vect)									//
 			if(button_state > 1){
 				button_state = 0;
 				button = BUTTON_ON;
+				click_ticks = 0;
 				sound_play(sound_button);
 			}
-		}else if(button == BUTTON_HOLD && mode == MODE_LIST) button = BUTTON_OFF;
+		}else if((button == BUTTON_HOLD && mode == MODE_LIST) || button == BUTTON_BACK) button = BUTTON_OFF;
 	}else{												// 
 		if(button_state == 60){
 			button_state++;
-			button = BUTTON_HOLD;
+			if(click_ticks < BROWSE_BACK_TICKS + 60 && (mode == MODE_LIST || mode == MODE_LOG)) button = BUTTON_BACK;	// ,  
+			else button = BUTTON_HOLD;
 			sound_play(sound_button2);
 		}
 		if(button_state < 60)button_state++;
 		timer = 0;
 	}
+	if(click_ticks < 0xFF) click_ticks++;
+	if(log_idle < 0xFFFF) log_idle++;
+	ticks++;
 	if(timer > 20000){									// , 5 
 		if(test_bat() < 600){timer = 0; return;}
 		timer -= 400;
@@ -116,6 +162,13 @@ ISR(TIMER2_OVF_vect)									//
 	timer++;
 }
 
+uint16_t ticks_get()									//16     
+{
+	uint16_t now;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) now = ticks;
+	return now;
+}
+
 void button_init()
 {
 	BUTTON_DDR &= ~(1 << BUTTON_LINE);
@@ -131,7 +184,7 @@ void adc_init()
 	ADCSRA = (1 << ADEN) 								//  
 	|(1 << ADSC) 										//  
 	|(1 << ADATE) 										//    
-	|(0 << ADPS2)|(1 << ADPS1)|(1 << ADPS0) 			//   8 (  148kHz)
+	|(1 << ADPS2)|(0 << ADPS1)|(0 << ADPS0) 			//   16 ( 1 ,  13 )
 	|(0 << ADIE); 										//  
 	ADCSRB = (0 << ADTS2)|(0 << ADTS1)|(0 << ADTS0); 	//    
 
@@ -140,25 +193,40 @@ void adc_init()
 	|(0); 												//  ADC0
 }
 
-uint8_t find_file_in_dir(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name, struct fat_dir_entry_struct* dir_entry)
+uint8_t find_file_in_dir(struct fat_dir_struct* dd, const char* name, struct fat_dir_entry_struct* dir_entry)
 {
-	while(fat_read_dir(dd, dir_entry))
-	{
-		if(strcmp(dir_entry->long_name, name) == 0)
-		{
-			file_size = dir_entry->file_size;
-			fat_reset_dir(dd);
-			return 1;
-		}
-	}
+	if(!fat_find_dir_entry(dd, name, dir_entry))
+		return 0;
 
-	return 0;
+	file_size = dir_entry->file_size;
+	return 1;
 }
+
+uint8_t eeprom_free_name()								//   eepromNN.bin    
+{
+	struct fat_dir_entry_struct dir_entry;
+	uint8_t used[13];
+	uint8_t i;
+	
+	memset(used, 0, sizeof(used));
+	fat_reset_dir(dd);
+	while(fat_read_dir(dd, &dir_entry)){
+		char* name = dir_entry.long_name;
+		if(strncmp(name, eeprom, 7) || strcmp(name+9, eeprom+9)) continue;
+		if(name[7] < '0' || name[7] > '9' || name[8] < '0' || name[8] > '9') continue;
+		i = (name[7] - '0') * 10 + name[8] - '0';
+		used[i >> 3] |= 1 << (i & 0x07);
+	}
+	for(i=0;i<99;i++) if(!(used[i >> 3] & (1 << (i & 0x07)))) break;
+	eeprom[7] = i/10 + '0';
+	eeprom[8] = i%10 + '0';
+	return i;
+}
 
 struct fat_file_struct* open_file_in_dir(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name)
 {
 	struct fat_dir_entry_struct file_entry;
-	if(!find_file_in_dir(fs, dd, name, &file_entry))
+	if(!find_file_in_dir(dd, name, &file_entry))
 	return 0;
 
 	return fat_open_file(fs, &file_entry);
@@ -176,14 +244,14 @@ uint8_t file_init()
 	}
 
 	/* open first partition */
-	partition = partition_open(sd_raw_read, sd_raw_read_interval, sd_raw_write, sd_raw_write_interval, 0);
+	partition = partition_open(sd_raw_read, sd_raw_read_stream, sd_raw_read_interval, sd_raw_read_interval_stream, sd_raw_write, sd_raw_write_stream, sd_raw_write_interval, 0);
 
 	if(!partition)
 	{
     /* If the partition did not open, assume the storage device
     * is a "superfloppy", i.e. has no MBR.
     */
-		partition = partition_open(sd_raw_read, sd_raw_read_interval, sd_raw_write, sd_raw_write_interval, -1);
+		partition = partition_open(sd_raw_read, sd_raw_read_stream, sd_raw_read_interval, sd_raw_read_interval_stream, sd_raw_write, sd_raw_write_stream, sd_raw_write_interval, -1);
 		if(!partition){
 			#ifdef UART
 			uart_puts_pstr("opening partition failed\r\n");
@@ -219,12 +287,13 @@ uint8_t file_init()
 		if(!fat_create_file(dd, logs, &directory))
 		{
 			#ifdef UART
-			uart_puts_pstr("error opening file: log.csv\r\n");
+			uart_puts_pstr("error opening file: log.bin\r\n");
 			#endif // UART
 			return 5;
 		}
 	}
 	fat_close_file(fd);
+	sd_raw_sync();
     /* search file in current directory and open it */
     fd = open_file_in_dir(fs, dd, keys);
     if(!fd)
@@ -377,6 +446,19 @@ void view_key_code()
 
 }
 
+void view_location(char* str)							//   5  6,   ';'
+{
+	lcd_goto_xy(1,5);
+	for(uint8_t byte=0;*str && byte<28;byte++){
+		if(*str++ != ';'){
+			lcd_chr(str[-1]);
+		} else {
+			lcd_goto_xy(1,6);
+			byte = 13;
+		}
+	}
+}
+
 void view_menu(uint8_t new_mode)
 {
 	lcd_clear();
@@ -439,6 +521,42 @@ void set_mode_write()
 	sound_play(sound_read);
 }
 
+uint8_t blank_last = DS_BLANK_TM2004;					//   
+uint8_t blank_time;										//   
+
+uint8_t dallas_program(uint8_t blank)
+{
+	switch(blank){
+		case DS_BLANK_TM08: return ds_program_tm08v2(out_data);
+		case DS_BLANK_RW1990: return ds_program_RW1990_2(out_data);
+	}
+	return ds_program_tm2004(out_data);
+}
+
+uint8_t dallas_copy(uint8_t presence)					// out_data,     blank_last
+{
+	uint8_t result = DS_READ_ROM_NO_PRES;
+	uint8_t blank, rotate = 0;
+	
+	blank = ds_blank_type(out_data);					//     
+	if(blank == DS_BLANK_UNKNOWN){						//  -   ,
+		rotate = 1;										// ,    
+		blank = DS_BLANK_TM2004;
+		if(presence + 3 >= blank_time && presence <= blank_time + 3) blank = blank_last;
+	}
+	for(uint8_t i=0;i<4 * 3;i++){
+		ds_verify_bit = 64;
+		result = dallas_program(blank);
+		if(result != DS_READ_ROM_CRC_ERR) break;
+		if(rotate || i >= 3) blank = blank % 3 + 1;		// - 4 ,   
+	}
+	if(result == DS_READ_ROM_OK){
+		blank_last = blank;
+		blank_time = presence;
+	}
+	return result;
+}
+
 uint8_t dallas_write()
 {
 	uint8_t result = DS_READ_ROM_NO_PRES;
@@ -446,6 +564,11 @@ uint8_t dallas_write()
 	
 	result = ds_read_rom(in_data);
 	if(result == DS_READ_ROM_NO_PRES) return 1;
+	if(result == DS_READ_ROM_MULTI){					//   ,   
+		view_error();
+		return 0;
+	}
+	uint8_t presence = ds_time;
 	view_write();
 						
 	for(uint8_t i=0;i<8;i++)
@@ -455,18 +578,12 @@ uint8_t dallas_write()
 		return 0;
 	}
 
-	for(uint8_t i=0;i<4;i++){
-		result = ds_program_tm2004(out_data);
-		if(result == DS_READ_ROM_OK){ tag = TAG_TM2004; break; }
-		if(result == DS_READ_ROM_NO_PRES) break;
-		result = ds_program_tm08v2(out_data);
-		if(result == DS_READ_ROM_OK){ tag = TAG_TM08; break; }
-		if(result == DS_READ_ROM_NO_PRES) break;
-		result = ds_program_RW1990_2(out_data);
-		if(result == DS_READ_ROM_OK){ tag = TAG_RW1990; break; }
-		if(result == DS_READ_ROM_NO_PRES) break;
-	}
+	uint16_t start = ticks_get();
+	result = dallas_copy(presence);
 	if(result == DS_READ_ROM_OK){
+		if(blank_last == DS_BLANK_TM2004) tag = TAG_TM2004;
+		if(blank_last == DS_BLANK_TM08) tag = TAG_TM08;
+		if(blank_last == DS_BLANK_RW1990) tag = TAG_RW1990;
 		lcd_clear();
 		lcd_goto_xy(1,3);
 		if(tag == TAG_RW1990){
@@ -488,14 +605,31 @@ uint8_t dallas_write()
 			#endif // UART
 		}
 		lcd_pstr(" ");
+		uint16_t ms = (uint32_t)(uint16_t)(ticks_get() - start) * TICK_US / 1000;	//     
+		lcd_goto_xy(1,4);
+		lcd_pstr(" ");
+		lcd_chr(ms / 1000 % 10 + '0');
+		lcd_chr(',');
+		lcd_chr(ms / 100 % 10 + '0');
+		lcd_chr(ms / 10 % 10 + '0');
+		lcd_pstr(" ");
 		#ifdef UART
-		uart_puts_pstr(" is recorded\r\n");
+		uart_puts_pstr(" is recorded in ");
+		uart_putw_dec(ms);
+		uart_puts_pstr(" ms\r\n");
 		#endif // UART
 		sound_play(sound_write);
 		_delay_ms(1000);
 		return 0;
 	}
 	if(result == DS_READ_ROM_CRC_ERR){
+		#ifdef UART
+		if(ds_verify_bit < 64){							//RW1990/TM08:    
+			uart_puts_pstr("Verify failed at bit ");
+			uart_putw_dec(ds_verify_bit);
+			uart_puts_pstr("\r\n");
+		}
+		#endif // UART
 		view_error();
 		return 0;
 	}
@@ -544,6 +678,77 @@ uint8_t resist_read(uint8_t* data)
 	return RES_NO_PRES;
 }
 
+void line_measure()
+{
+	uint16_t sum = 0;
+	uint8_t min = 0xFF, max = 0;
+
+	ADMUX = (0 << REFS1)|(1 << REFS0) 					//   AVCC
+	|(1 << ADLAR)										//   (  1,  8   ADCH)
+	|(0); 												//  ADC0
+	_delay_us(20);
+
+	for(uint8_t i=0;i<100;i++){							//     
+		uint8_t u = ADCH;
+		sum += u;
+		if(u < min) min = u;
+		if(u > max) max = u;
+		_delay_us(10);
+	}
+	line_avg = sum / 100;
+	line_swing = max - min;
+}
+
+uint8_t probe_run(uint8_t probe)
+{
+	switch(probe){
+		case PROBE_DALLAS:{								// :  RFID    ,
+			uint8_t rfid_data[8];						// -01      Dallas
+			uint8_t ds_result = ds_read_rom(in_data);
+			if(ds_result == DS_READ_ROM_MULTI) return KEY_MULTI;
+			if(ds_result != DS_READ_ROM_NO_PRES) return KEY_DALLAS;
+			if(rfid_read(rfid_data) == RFID_OK){			//in_data    
+				for(uint8_t i=0;i<8;i++) in_data[i] = rfid_data[i];
+				return KEY_RFID;
+			}
+			if(kt_read_rom(in_data) != KT_NO_KEY) return KEY_KT01;
+			break;
+		}
+		case PROBE_MK_CL:{								//      
+			uint8_t found = KEY_NO_KEY;
+			if(line_avg >= LINE_IDLE) break;				//   
+			adc_capture_start(MK_ADC, line_avg, ADC_SAMPLED);
+			if(mk_read(in_data) == MK_READ_OK) found = KEY_METAKOM;
+			else if(cl_read(in_data) == CL_READ_OK) found = KEY_CYFRAL;
+			adc_capture_stop();
+			return found;
+		}
+		case PROBE_RESIST:{
+			if(line_swing >= LINE_SWING) break;			//  ,   
+			if(resist_read(in_data) == RES_READ_OK) return KEY_RESIST;
+			break;
+		}
+	}
+	return KEY_NO_KEY;
+}
+
+uint8_t probe_key()
+{
+	uint8_t probe = probe_order[probe_slot];
+	uint8_t found;
+
+	if(probe == PROBE_MK_CL || probe == PROBE_RESIST) line_measure();	//    ,   
+	found = probe_run(probe);
+	if(found == KEY_NO_KEY){
+		if(++probe_slot >= PROBE_END) probe_slot = 0;
+		return KEY_NO_KEY;
+	}
+	for(uint8_t i=probe_slot;i>0;i--) probe_order[i] = probe_order[i-1];	//     
+	probe_order[0] = probe;
+	probe_slot = 0;
+	return found;
+}
+
 void str_add_p(char* buffer, const char *progmem_s)
 {
 	register char c;
@@ -669,16 +874,16 @@ void cmd_parse(char* string)
 }
 #endif // UART
 
-uint8_t file_read(char* file, uint8_t search)
+uint8_t file_read(uint8_t search)						//    fd keys.csv
 {
 	uint16_t size, i;
 	static uint8_t street[14];
 	uint8_t skip = 0;
+	int32_t line;
 	do{
-		fd = open_file_in_dir(fs, dd, file);
+		line = file_seek;
 		fat_seek_file(fd, &file_seek, FAT_SEEK_SET);
 		size = fat_read_file(fd, (uint8_t*)file_buf, sizeof(file_buf));
-		fat_close_file(fd);
 		if(size == 0){
 			file_seek = 0;
 			return 1;
@@ -726,6 +931,8 @@ uint8_t file_read(char* file, uint8_t search)
 		if(skip > 20) search = 0;
 	}while(search);
 
+	list_back[list_back_pos++ & (LIST_BACK_SIZE-1)] = line;
+	if(list_back_count < LIST_BACK_SIZE) list_back_count++;
 	lcd_clear();
 	ds_time = 0;
 	view_key_type();
@@ -735,54 +942,220 @@ uint8_t file_read(char* file, uint8_t search)
 		if(file_buf[i+byte]==';')break;
 		street[byte] = file_buf[i+byte];
 	}
-	lcd_goto_xy(1,5);
-	for(uint8_t byte=0;file_buf[i] && byte<28;byte++){
-		if(file_buf[i++] != ';'){
-			lcd_chr(file_buf[i-1]);
-		} else {
-			lcd_goto_xy(1,6);
-			byte = 13;
-		}
+	view_location(&file_buf[i]);
+	return 0;
+}
+
+uint8_t list_read(uint8_t search)						//   fd keys.kdb   
+{
+	struct keydb_record_struct record;
+	
+	if(search && list_pos && keydb_read_sorted(fd, &list_db, list_pos-1, &record)){	//   
+		list_pos = keydb_location_first(fd, &list_db, record.location+1);
 	}
+	if(!keydb_read_sorted(fd, &list_db, list_pos, &record) || !keydb_location(fd, &list_db, record.location, file_buf)){
+		list_pos = 0;
+		return 1;
+	}
+	list_pos++;
+
+	key = record.type;
+	for(uint8_t i=0;i<8;i++) out_data[i] = record.code[i];
+	lcd_clear();
+	ds_time = 0;
+	view_key_type();
+	view_key_code();
+	view_location(file_buf);
 	return 0;
 }
 
-void logs_write()
+uint8_t list_prev(uint8_t list_kdb, uint8_t steps)		// steps    
 {
-	for(uint8_t i=0;i<8;i++){
-		str_put_hex(file_buf+i*3, out_data[7-i]);
-		file_buf[i*3+2] = ' ';
+	if(list_kdb){
+		list_pos = list_pos > steps ? list_pos - 1 - steps : 0;
+		return list_read(0);
+	}
+	if(list_back_count > steps){
+		list_back_count -= steps + 1;
+		list_back_pos -= steps + 1;
+		file_seek = list_back[list_back_pos & (LIST_BACK_SIZE-1)];
+	}else{												//  -   
+		list_back_count = 0;
+		file_seek = 0;
 	}
+	return file_read(0);
+}
+
+void view_key_location()								//    keys.kdb
+{
+	struct keydb_struct db;
+	struct keydb_record_struct record;
+	uint8_t found = 0;
+	
+	fd = open_file_in_dir(fs, dd, keydb);
+	if(keydb_open(fd, &db) && keydb_find(fd, &db, out_data, &record) != KEYDB_NONE){
+		found = keydb_location(fd, &db, record.location, file_buf);
+	}
+	fat_close_file(fd);
+	if(found) view_location(file_buf);
+}
+
+void logs_flush()										//     
+{
+	if(log_head == log_tail) return;
+	fd = open_file_in_dir(fs, dd, logs);
+	if(!fd) return;
+	journal_open(fd);
+	while(log_head != log_tail){
+		if(!journal_append(fd, &log_ring[log_tail & (LOG_RING_SIZE-1)])) break;
+		log_tail++;
+	}
+	/*        ,    
+	 *  :          */
+	fat_close_file(fd);
+	sd_raw_sync();										//    
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) log_idle = 0;
+}
+
+uint8_t log_read()										//   fd    
+{
+	struct journal_record_struct record;
+	
+	if(log_pos >= log_count || !journal_read(fd, log_pos, &record)){
+		log_pos = 0;
+		return 1;
+	}
+
+	key = record.key;
+	for(uint8_t i=0;i<8;i++) out_data[i] = record.code[i];
+	lcd_clear();
+	ds_time = 0;
+	view_key_type();
+	view_key_code();
+	log_pos++;
+	str_putdw_dec(file_buf, log_pos);
+	str_add_p(file_buf+strlen(file_buf), PSTR("  "));
+	str_putdw_dec(file_buf+strlen(file_buf), log_count);
+	if(record.count > 1){								// 
+		str_add_p(file_buf+strlen(file_buf), PSTR("; "));
+		str_putdw_dec(file_buf+strlen(file_buf), record.count);
+	}
+	view_location(file_buf);
+	return 0;
+}
+
+uint8_t log_prev(uint8_t steps)
+{
+	log_pos = log_pos > steps ? log_pos - 1 - steps : 0;
+	return log_read();
+}
+
+void logs_write(uint16_t count)							//  ,     logs_flush()
+{
 	switch(key){
-		case KEY_DALLAS: str_add_p(file_buf+23, PSTR(";;")); break;
-		case KEY_RFID: str_add_p(file_buf+23, PSTR(";;")); break;
-		case KEY_KT01: str_add_p(file_buf+23, PSTR(";-01;")); break;
-		case KEY_METAKOM: str_add_p(file_buf+23,PSTR(";;")); break;
-		case KEY_CYFRAL: str_add_p(file_buf+23, PSTR(";;")); break;
+		case KEY_DALLAS: case KEY_RFID: case KEY_KT01: case KEY_METAKOM: case KEY_CYFRAL: break;
 		default: return;
 	}
-	int32_t offset = 0;
-	fd = open_file_in_dir(fs, dd, logs);
-	if(!fat_seek_file(fd, &offset, FAT_SEEK_END))
-	{
-		fat_close_file(fd);
-		return;
+	if((uint8_t)(log_head - log_tail) == LOG_RING_SIZE) logs_flush();
+	if((uint8_t)(log_head - log_tail) == LOG_RING_SIZE) log_tail++;	// ,   
+	struct journal_record_struct* entry = &log_ring[log_head & (LOG_RING_SIZE-1)];
+	entry->key = key;
+	for(uint8_t i=0;i<8;i++) entry->code[i] = out_data[i];
+	entry->count = count;
+	log_head++;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) log_idle = 0;	//16 ,    
+}
+
+void logs_count(uint16_t count)							//     ,     
+{
+	if(log_head != log_tail){
+		struct journal_record_struct* entry = &log_ring[(uint8_t)(log_head - 1) & (LOG_RING_SIZE-1)];
+		if(entry->key == key && !memcmp(entry->code, out_data, 8)){
+			entry->count = count;
+			return;
+		}
 	}
+	logs_write(count);
+}
 
-	uint8_t size = strlen(file_buf);
-	str_putdw_dec(file_buf+size, file_size/35);
-	size = strlen(file_buf);
-	str_add_p(file_buf+size, PSTR(";\r\n"));
-
-	/* write text to file */
-	uint16_t data_len = strlen(file_buf);
-	if(fat_write_file(fd, (uint8_t*) file_buf, data_len) != data_len)
-	{
-		fat_close_file(fd);
-		return;
+void view_multi()										//     Search ROM,   
+{
+	uint8_t count = 0;
+	
+	lcd_clear();
+	#ifdef UART
+	uart_puts_pstr("Several keys:\r\n");
+	#endif // UART
+	key = KEY_DALLAS;
+	for(uint8_t result = ds_search(out_data, 1); result == DS_READ_ROM_OK; result = ds_search(out_data, 0)){
+		count++;
+		if(count < 6){									// 2-6,      CRC
+			lcd_goto_xy(1,count+1);
+			for(uint8_t i=0;i<6;i++) lcd_hex(out_data[6-i]);
+		}
+		#ifdef UART
+		for(uint8_t i=0;i<8;i++){
+			uart_putc_hex(out_data[7-i]);
+			if(i<7)uart_putc(':');
+		}
+		uart_puts_pstr("\r\n");
+		#endif // UART
+		logs_write(1);
 	}
-	fat_close_file(fd);
-	return;
+	key = KEY_NO_KEY;
+	lcd_goto_xy(1,1);
+	lcd_pstr(": ");
+	str_putdw_dec(file_buf, count);
+	lcd_str(file_buf);
+}
+
+uint8_t batch_poll(uint8_t present)						//  , 0 -    
+{
+	uint8_t polls = 0;
+	
+	while(polls < BATCH_POLLS){
+		if(button != BUTTON_OFF) return 0;
+		#ifdef UART
+		if(user_rx == USER_CMD) return 0;
+		#endif // UART
+		if((ds_timeslot() != 0) == present) polls++;	//    
+		else polls = 0;
+		_delay_ms(BATCH_POLL_MS);
+	}
+	return 1;
+}
+
+uint8_t batch_copy(uint8_t known)						//   , known -    
+{
+	uint8_t result = ds_read_rom(in_data);
+	if(result == DS_READ_ROM_NO_PRES) return BATCH_LOST;
+	if(result == DS_READ_ROM_MULTI) return BATCH_ERROR;
+	uint8_t presence = ds_time;
+	
+	for(uint8_t i=0;i<8;i++)
+		if(in_data[i] != out_data[i]) result = DS_READ_ROM_NO_PRES;
+	if(result != DS_READ_ROM_NO_PRES) return BATCH_SKIPPED;
+	
+	result = DS_READ_ROM_CRC_ERR;
+	if(known && presence + 3 >= blank_time && presence <= blank_time + 3) result = dallas_program(blank_last);	//    
+	if(result == DS_READ_ROM_CRC_ERR) result = dallas_copy(presence);
+	if(result == DS_READ_ROM_OK) return BATCH_COPIED;
+	return result == DS_READ_ROM_NO_PRES ? BATCH_LOST : BATCH_ERROR;
+}
+
+void view_batch(uint16_t copies, uint16_t rate)			// 4  5   
+{
+	lcd_goto_xy(1,4);
+	lcd_pstr(": ");
+	str_putdw_dec(file_buf, copies);
+	str_add_p(file_buf+strlen(file_buf), PSTR("      "));
+	lcd_str(file_buf);
+	lcd_goto_xy(1,5);
+	lcd_pstr(" : ");
+	str_putdw_dec(file_buf, rate);
+	str_add_p(file_buf+strlen(file_buf), PSTR("    "));
+	lcd_str(file_buf);
+	lcd_goto_xy(1,6);
 }
 
 /*************************************** *********************************************/
@@ -814,10 +1187,16 @@ int main (void)
 			lcd_clear();
 			view_key_type();
 			view_key_code();
-			logs_write();
+			view_key_location();
+			logs_write(1);
 			
 			if(key == KEY_DALLAS){		//****************************************************************** WRITE DALLAS
 				while(1){
+					if(button == BUTTON_HOLD){				// -    
+						button = BUTTON_OFF;
+						mode = MODE_BATCH;
+						break;
+					}
 					if(button != BUTTON_OFF){
 						button = BUTTON_OFF;
 						mode = MODE_READ;
@@ -964,9 +1343,7 @@ int main (void)
 						out_data[0] = 0x01;
 						out_data[5] = 0;
 						out_data[6] = 0;
-						uint8_t temp = 0;
-						for(uint8_t i=0;i<7;i++) temp = ds_crc(temp,out_data[i]);
-						out_data[7] = temp;
+						out_data[7] = ds_crc_block(out_data, 7);
 						break;
 					}
 					if(button == BUTTON_HOLD){
@@ -999,9 +1376,7 @@ int main (void)
 								out_data[i] = out_data[5-i];
 								out_data[5-i] = temp;
 							}
-							temp = 0;
-							for(uint8_t i=0;i<7;i++) temp = ds_crc(temp,out_data[i]);
-							out_data[7] = temp;
+							out_data[7] = ds_crc_block(out_data, 7);
 							break;
 						} else {
 							key = KEY_METAKOM;
@@ -1035,9 +1410,7 @@ int main (void)
 						button = BUTTON_OFF;
 						key = KEY_CY_DAL_1;
 						out_data[0] = 0x01;
-						temp = 0;
-						for(uint8_t i=0;i<7;i++) temp = ds_crc(temp,out_data[i]);
-						out_data[7] = temp;
+						out_data[7] = ds_crc_block(out_data, 7);
 						break;
 					}
 					if(button == BUTTON_HOLD){
@@ -1070,9 +1443,7 @@ int main (void)
 								out_data[i] |= pgm_read_byte(&cy_dal_2_tbl[(temp >> 4) & 0x0F]) << 4;
 							}
 							out_data[3] = 0x80;
-							temp = 0;
-							for(uint8_t i=0;i<7;i++) temp = ds_crc(temp,out_data[i]);
-							out_data[7] = temp;
+							out_data[7] = ds_crc_block(out_data, 7);
 							break;
 						} else {
 							key = KEY_CYFRAL;
@@ -1105,6 +1476,66 @@ int main (void)
 			}
 			if(key >= KEY_RESIST) mode = MODE_READ;
 		}
+		while(mode == MODE_BATCH){		//****************************************************************** BATCH
+			uint16_t copies = 0, skipped = 0, errors = 0, last = ticks_get();
+			uint32_t elapsed = 0;								//   , ticks   18 
+			uint8_t known = 0;
+			
+			lcd_clear();
+			ds_time = 0;
+			view_key_type();
+			view_key_code();
+			view_batch(0, 0);
+			lcd_pstr(" ");
+			#ifdef UART
+			uart_puts_pstr("Batch\r\n");
+			#endif // UART
+			while(batch_poll(1)){
+				uint16_t now = ticks_get();
+				if(copies || skipped || errors) elapsed += (uint16_t)(now - last);
+				uint8_t result = batch_copy(known);
+				last = ticks_get();
+				elapsed += (uint16_t)(last - now);
+				if(result == BATCH_LOST) continue;
+				if(result == BATCH_COPIED){
+					copies++;
+					known = 1;
+					sound_play(sound_write);
+				}
+				if(result == BATCH_SKIPPED){
+					skipped++;
+					sound_play(sound_exist);
+				}
+				if(result == BATCH_ERROR){
+					errors++;
+					known = 0;
+					sound_play(sound_error);
+				}
+				view_batch(copies, elapsed ? copies * TICKS_PER_MIN / elapsed : 0);
+				if(result == BATCH_COPIED) lcd_pstr("  ");
+				if(result == BATCH_SKIPPED) lcd_pstr("    ");
+				if(result == BATCH_ERROR) lcd_pstr(" ");
+				if(!batch_poll(0)) break;
+				lcd_goto_xy(1,6);
+				lcd_pstr("  ");
+			}
+			if(button != BUTTON_OFF){
+				button = BUTTON_OFF;
+				mode = MODE_READ;
+			}
+			#ifdef UART
+			if(user_rx == USER_CMD) cmd_parse(user_cmd);
+			uart_puts_pstr("Batch copies ");
+			uart_putw_dec(copies);
+			uart_puts_pstr(", skipped ");
+			uart_putw_dec(skipped);
+			uart_puts_pstr(", errors ");
+			uart_putw_dec(errors);
+			uart_puts_pstr("\r\n");
+			#endif // UART
+			if(copies) logs_count(copies);					//     
+			if(mode == MODE_BATCH) mode = MODE_READ;
+		}
 		while(mode == MODE_READ){		//****************************************************************** READING
 			mode_loop = MODE_WRITE;
 			lcd_clear();			
@@ -1136,37 +1567,9 @@ int main (void)
 			#endif // UART
 			
 			while(1){
-				if(ds_read_rom(in_data) != DS_READ_ROM_NO_PRES){
-					key = KEY_DALLAS;
-					set_mode_write();
-					break;
-				}
-				
-				if(rfid_read(in_data) == RFID_OK){
-					key = KEY_RFID;
-					set_mode_write();
-					break;
-				}
-				
-				if(kt_read_rom(in_data) != KT_NO_KEY){
-					key = KEY_KT01;
-					set_mode_write();
-					break;
-				}
-				
-				if(mk_read(in_data) == MK_READ_OK){
-					key = KEY_METAKOM;
-					set_mode_write();
-					break;
-				}
-				
-				if(cl_read(in_data) == CL_READ_OK){
-					key = KEY_CYFRAL;
-					set_mode_write();
-					break;
-				}
+				uint8_t found = probe_key();
 				
-				if(resist_read(in_data) == RES_READ_OK){
+				if(found == KEY_RESIST){
 					sound_play(sound_read);
 					while(button == BUTTON_OFF){
 						key = KEY_RESIST;
@@ -1187,6 +1590,29 @@ int main (void)
 					break;
 				}
 				
+				if(found == KEY_MULTI){
+					sound_play(sound_read);
+					view_multi();
+					while(button == BUTTON_OFF && ds_timeslot()) _delay_ms(100);	//  
+					button = BUTTON_OFF;						// -  
+					break;
+				}
+				
+				if(found != KEY_NO_KEY){
+					key = found;
+					set_mode_write();
+					break;
+				}
+				
+				if(log_head != log_tail && (uint16_t)(ticks_get() - bat_ticks) >= BAT_CHECK_TICKS){
+					bat_ticks = ticks_get();					//    probe_key(),   
+					test_bat();
+				}
+				
+				uint16_t idle;
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) idle = log_idle;
+				if(log_head != log_tail && (bat_low || (uint8_t)(log_head - log_tail) >= LOG_FLUSH_COUNT || idle > LOG_IDLE_TICKS)) logs_flush();
+				
 				if(button == BUTTON_ON){
 					button = BUTTON_OFF;
 					break;
@@ -1249,9 +1675,18 @@ int main (void)
 				break;
 			}
 			fat_close_file(fd);
+			fd = open_file_in_dir(fs, dd, keydb);			//      
+			uint8_t list_kdb = keydb_open(fd, &list_db);
+			if(!list_kdb){
+				fat_close_file(fd);
+				fd = open_file_in_dir(fs, dd, keys);
+			}
 			ds_time = 0;
 			uint16_t time = 0;
+			uint8_t back = 2;
 			file_seek = 0;
+			list_pos = 0;
+			list_back_count = 0;
 			button = BUTTON_ON;
 			while(1){
 				time++;
@@ -1263,11 +1698,19 @@ int main (void)
 				}
 				if(button == BUTTON_ON){
 					button = BUTTON_OFF;
-					if(file_read(keys,0)){mode = MODE_READ;break;}
+					if(list_kdb ? list_read(0) : file_read(0)){mode = MODE_READ;break;}
+					back = 2;									//     
+					time = 0;
+				}
+				if(button == BUTTON_BACK){
+					list_prev(list_kdb, back);
+					back = 1;
+					_delay_ms(700);
 					time = 0;
 				}
 				if(button == BUTTON_HOLD){
-					file_read(keys,1);
+					if(list_kdb) list_read(1);
+					else file_read(1);
 					_delay_ms(700);
 					time = 0;
 				}
@@ -1278,9 +1721,11 @@ int main (void)
 				}
 				#endif // UART
 			}
+			fat_close_file(fd);
 		}
 		
 		while(mode == MODE_LOG){ //************************************************************************* LOG
+			logs_flush();
 			fd = open_file_in_dir(fs, dd, logs);
 			if(!fd){
 				#ifdef UART
@@ -1289,10 +1734,12 @@ int main (void)
 				mode = MODE_READ;
 				break;
 			}
-			fat_close_file(fd);
+			log_count = journal_open(fd);					//      
+			sd_raw_sync();									//    
 			ds_time = 0;
 			uint16_t time = 0;
-			file_seek = 0;
+			uint8_t back = 2;
+			log_pos = 0;
 			button = BUTTON_ON;
 			while(1){
 				time++;
@@ -1304,11 +1751,18 @@ int main (void)
 				}
 				if(button == BUTTON_ON){
 					button = BUTTON_OFF;
-					if(file_read(logs,0)){mode = MODE_READ;break;}
+					if(log_read()){mode = MODE_READ;break;}
+					back = 2;
+					time = 0;
+				}
+				if(button == BUTTON_BACK){
+					log_prev(back);
+					back = 1;
+					_delay_ms(700);
 					time = 0;
 				}
 				if(button == BUTTON_HOLD){
-					file_read(logs,0);
+					log_read();
 					_delay_ms(100);
 					time = 0;
 				}
@@ -1319,9 +1773,11 @@ int main (void)
 				}
 				#endif // UART
 			}
+			fat_close_file(fd);
 		}
 		while(mode == MODE_CLEAR){ //*********************************************************************** CLEAR
 			mode = MODE_READ;
+			log_tail = log_head;							//  
 			fd = open_file_in_dir(fs, dd, logs);
 			if(!fd){
 				#ifdef UART
@@ -1331,7 +1787,8 @@ int main (void)
 			}
 			fat_resize_file(fd,0);
 			fat_close_file(fd);
-			file_seek = 0;
+			sd_raw_sync();
+			log_pos = 0;
 			lcd_clear();
 			lcd_goto_xy(3,3);
 			lcd_pstr(" !");
@@ -1339,11 +1796,9 @@ int main (void)
 		while(mode == MODE_RAND_DALLAS){ //***************************************************************** RAND_DALLAS
 			out_data[0] = 0x01;
 			for(uint8_t i=1;i<5;i++) out_data[i] = rand();
-			uint8_t temp = 0;
-			out_data[5] = temp;
-			out_data[6] = temp;
-			for(uint8_t i=0;i<7;i++) temp = ds_crc(temp, out_data[i]);
-			out_data[7] = temp;
+			out_data[5] = 0;
+			out_data[6] = 0;
+			out_data[7] = ds_crc_block(out_data, 7);
 			key = KEY_DALLAS;
 			mode = MODE_WRITE;
 			mode_loop = MODE_RAND_DALLAS;
@@ -1385,7 +1840,7 @@ int main (void)
 				lcd_hex(offset);
 				offset+=32;
 				lcd_goto_xy(1,1);
-				while(button == BUTTON_OFF);
+				while(button == BUTTON_OFF) hal_idle();
 				if(button == BUTTON_ON) button = BUTTON_OFF;
 			}
 			VCC_OFF();
@@ -1394,35 +1849,26 @@ int main (void)
 		}
 		while(mode == MODE_24C16_TO_FILE || mode == MODE_24C64_TO_FILE){ //********************************* EEPROM_TO_FILE
 			uint8_t error = 0;
-			uint8_t no_file = 0;
 			uint8_t last_mode = mode;
 			mode = MODE_READ;
 			VCC_ON();
 			lcd_clear();
-			for(uint8_t i=0;i<100;i++){
-				eeprom[7] = i/10 + '0';
-				eeprom[8] = i%10 + '0';
-				fd = open_file_in_dir(fs, dd, eeprom);
-				if(!fd){
-					no_file = 1;
-					if(!fat_create_file(dd, eeprom, &directory))
-					{
-						#ifdef UART
-						uart_puts_pstr("error opening file: eeprom___.bin\r\n");
-						#endif // UART
-						lcd_goto_xy(1,3);
-						lcd_pstr(" !");
-						sound_play(sound_error);
-						VCC_OFF();
-						_delay_ms(1000);
-						break;
-					}
-				}else{
-					no_file = 0;
+			eeprom_free_name();
+			fd = open_file_in_dir(fs, dd, eeprom);
+			if(!fd){
+				if(!fat_create_file(dd, eeprom, &directory))
+				{
+					#ifdef UART
+					uart_puts_pstr("error opening file: eeprom___.bin\r\n");
+					#endif // UART
+					lcd_goto_xy(1,3);
+					lcd_pstr(" !");
+					sound_play(sound_error);
+					VCC_OFF();
+					_delay_ms(1000);
 				}
-				fat_close_file(fd);
-				if(no_file) break;
 			}
+			fat_close_file(fd);
 			fd = open_file_in_dir(fs, dd, eeprom);
 			if(!fd){
 				#ifdef UART
@@ -1465,6 +1911,7 @@ int main (void)
 			}
 			VCC_OFF();
 			fat_close_file(fd);
+			sd_raw_sync();
 			lcd_clear();
 			lcd_goto_xy(1,3);
 			lcd_pstr("  : ");
@@ -1472,7 +1919,7 @@ int main (void)
 			lcd_str(eeprom);
 			eeprom[7] = '_';
 			eeprom[8] = '_';
-			while(button == BUTTON_OFF);
+			while(button == BUTTON_OFF) hal_idle();
 			if(button == BUTTON_ON) button = BUTTON_OFF;
 		}
 		if(mode != MODE_READ && mode != MODE_WRITE) mode = MODE_READ;
@@ -4,11 +4,11 @@
  * Created: 30.01.2016 2:13:32
  *  Author: Elektron
  */ 
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal.h"
+#include <stdint.h>
+#include "adc.h"
 #include "metakom.h"
 
-#define AVG_U_SUM 100
 #define AVG_T_SUM 100
 
 uint8_t mk_crc(uint8_t* data)
@@ -33,61 +33,34 @@ uint8_t mk_crc(uint8_t* data)
 	return MK_READ_OK;
 }
 
-uint8_t mk_read(uint8_t* data)
+uint8_t mk_read(uint8_t* data)								//      MK_ADC
 {
 	uint16_t sum = 0;
-	uint8_t avg_t = 0, avg_u = 0, temp = 0;
-	
-	ADMUX = (0 << REFS1)|(1 << REFS0) 					//   AVCC
-	|(1 << ADLAR)										//   (  1,  8   ADCH)
-	|(MK_ADC); 											//  MK_ADC
-	_delay_us(20);
+	uint8_t pos, entry;
 	
 	for(uint8_t i=0;i<9;i++)mk_code[i] = 0;					//  
 
-	for(uint8_t i=0;i<AVG_U_SUM;i++){						//  
-		sum += ADCH;
-		_delay_us(10);
-	}
-	avg_u = sum / AVG_U_SUM;
-	sum = 0;
-	for(uint8_t u=0,i=0;i<AVG_T_SUM;i++){					//    
-		for(uint8_t t=0;t<200;t++){
-			if(ADCH < avg_u && u){sum += t; u = 0;break;}
-			if(ADCH > avg_u && !u){sum += t; u = 1;break;}
-			_delay_us(4);
-		}
+	for(pos=1;pos<=AVG_T_SUM;pos++){						//    
+		entry = adc_wait(pos);
+		if(entry == 0) return MK_NO_KEY;
+		sum += ADC_LEN(entry);
 	}
-	avg_t = sum / AVG_T_SUM;
-	if(avg_t < 5 || avg_t > 23) return MK_NO_KEY;
+	if(sum < ADC_SAMPLES(20UL*AVG_T_SUM) || sum > ADC_SAMPLES(92UL*AVG_T_SUM)) return MK_NO_KEY;
 
-	for(uint8_t i=0;i<255;i++){								//  
-		uint8_t t;
-		_delay_us(10);
-		if(ADCH >= avg_u) continue;
-		for (t=0;t<100;t++){
-			_delay_us(10);
-			if(ADCH > avg_u) break;
-		}
-		if(t > avg_t) {temp = 1;break;}
+	for(pos=1;;pos++){										//  
+		entry = adc_wait(pos);
+		if(entry == 0) return MK_NO_KEY;
+		if(!(entry & ADC_HIGH) && (uint16_t)ADC_LEN(entry) * AVG_T_SUM * 2 > sum * 5) break;
 	}
-	if(temp == 0) return MK_NO_KEY;
 	
 	for(uint8_t i=0;i<70;i++){							//         
-		uint8_t t;
-		for (t=0;t<=150;t++){
-			if(ADCH < avg_u) break;
-			_delay_us(4);
-		}
-		if(t == 150) return MK_NO_KEY;
+		entry = adc_wait(++pos);
+		if(entry == 0 || ADC_LEN(entry) > ADC_SAMPLES(600)) return MK_NO_KEY;
 		
-		if(t > avg_t) mk_code[i/8] |= 0x80>>(i%8);
+		if((uint16_t)ADC_LEN(entry) * AVG_T_SUM > sum) mk_code[i/8] |= 0x80>>(i%8);
 		
-		for (t=0;t<=150;t++){
-			if(ADCH > avg_u) break;
-			_delay_us(4);
-		}
-		if(t == 150) return MK_NO_KEY;		
+		entry = adc_wait(++pos);
+		if(entry == 0 || ADC_LEN(entry) > ADC_SAMPLES(600)) return MK_NO_KEY;
 	}
 	
 	return mk_crc(data);
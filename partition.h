@@ -158,6 +158,16 @@ struct partition_struct
      *       not to the start of the partition.
      */
     device_read_t device_read;
+    /**
+     * The function which reads sequential data from the partition.
+     *
+     * It may keep the device busy with a read ahead between calls, so
+     * use it only when the next access is likely to continue the data.
+     *
+     * \note The offset given to this function is relative to the whole disk,
+     *       not to the start of the partition.
+     */
+    device_read_t device_read_stream;
     /**
      * The function which repeatedly reads a constant amount of data from the partition.
      *
@@ -165,6 +175,16 @@ struct partition_struct
      *       not to the start of the partition.
      */
     device_read_interval_t device_read_interval;
+    /**
+     * The function which reads a large area in constant intervals.
+     *
+     * It may bypass a block cache and keep the device busy with a read
+     * ahead between calls, so use it for scans which touch every block.
+     *
+     * \note The offset given to this function is relative to the whole disk,
+     *       not to the start of the partition.
+     */
+    device_read_interval_t device_read_interval_stream;
     /**
      * The function which writes data to the partition.
      *
@@ -172,6 +192,16 @@ struct partition_struct
      *       not to the start of the partition.
      */
     device_write_t device_write;
+    /**
+     * The function which appends sequential data to the partition.
+     *
+     * It may keep written data in a buffer and the device busy between
+     * calls, any other access to the device writes it out.
+     *
+     * \note The offset given to this function is relative to the whole disk,
+     *       not to the start of the partition.
+     */
+    device_write_t device_write_stream;
     /**
      * The function which repeatedly writes data to the partition.
      *
@@ -196,7 +226,7 @@ struct partition_struct
     uint32_t length;
 };
 
-struct partition_struct* partition_open(device_read_t device_read, device_read_interval_t device_read_interval, device_write_t device_write, device_write_interval_t device_write_interval, int8_t index);
+struct partition_struct* partition_open(device_read_t device_read, device_read_t device_read_stream, device_read_interval_t device_read_interval, device_read_interval_t device_read_interval_stream, device_write_t device_write, device_write_t device_write_stream, device_write_interval_t device_write_interval, int8_t index);
 uint8_t partition_close(struct partition_struct* partition);
 
 /**
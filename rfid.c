@@ -1,13 +1,12 @@
-#include <avr/io.h>
+#include "hal.h"
 #include <stdint.h>
-#include <util/delay.h>
+#include "adc.h"
 #include "rfid.h"
 
 #define FieldOn()	DDRD |= 1<<RFID_OUT;
 #define FieldOff()	DDRD &= ~(1<<RFID_OUT);
 
 uint8_t rfid_buffer [RFID_BUFFER_SIZE];  // -
-uint8_t avg_u;
 
 void rfid_init()
 {
@@ -48,79 +47,108 @@ void rfid_encode(uint8_t* data)
 	}
 }
 
-uint8_t inline rfid_in()
+#define EM4100_FRAME 55									//   : 10 ,  , -
+
+static uint8_t em_window[7];								// 56 ,  0 em_window[0] -  
+static uint8_t em_bits, em_ones, em_skip;
+
+static uint8_t em4100_at(uint8_t k)							//,  k  
+{
+	return (em_window[k>>3] >> (k & 0x07)) & 0x01;
+}
+
+void em4100_sync(void)										//  
 {
-	if(ADCH > avg_u) return 1;
-	return 0;
+	em_bits = 0;
+	em_ones = 0;
+	em_skip = 0;
+}
+
+//  EM4100:       , 
+//,   ,   (     )
+uint8_t em4100_bit(uint8_t bit, uint8_t* code)
+{
+	for(uint8_t i=6;i>0;i--) em_window[i] = em_window[i] << 1 | em_window[i-1] >> 7;
+	em_window[0] = em_window[0] << 1 | bit;
+	if(em_bits < EM4100_FRAME){em_bits++; return RFID_NO_KEY;}
+	if(em_skip){em_skip = 0; return RFID_NO_KEY;}			//      
+	if(em4100_at(EM4100_FRAME)) em_ones++;
+	else em_ones = 0;
+	if(em_ones < 9) return RFID_NO_KEY;						//   9 
+	em_ones = 0;
+
+	uint8_t cp = 0;
+	for(uint8_t row=0,j=0;row<11;row++){					//    
+		uint8_t rp = 0;
+		for(uint8_t col=0;col<5 && j<EM4100_FRAME-1;col++,j++){
+			uint8_t b = em4100_at(EM4100_FRAME-1-j);
+			rp ^= b;
+			if(col < 4) cp ^= b<<col;
+		}
+		if(row < 10 && rp){em_skip = 1; return RFID_PARITY_ERR;}
+	}
+	if(cp || em4100_at(0)){em_skip = 1; return RFID_PARITY_ERR;}	//    -
+	for(uint8_t i=0;i<8;i++) code[i] = 0;
+	for(uint8_t row=0;row<10;row++)
+		for(uint8_t col=0;col<4;col++)
+			if(em4100_at(EM4100_FRAME-1-row*5-col)) code[5-(row>>1)] |= 0x80>>((row & 0x01)*4+col);
+	return RFID_OK;
 }
 
 uint8_t rfid_read(uint8_t* data)
 {
-	uint16_t sum = 0;
-	ADMUX = (0 << REFS1)|(1 << REFS0) 					//   AVCC
-	|(1 << ADLAR)										//   (  1,  8   ADCH)
-	|(RFID_IN);											//  RFID_IN
+	uint8_t half = ADC_LEN_MAX;
+	uint8_t code[8];
+	uint8_t result = RFID_PARITY_ERR;
+	#if RFID_CONFIRM
+	uint8_t frames = 0;
+	#endif
 	
-	for(uint8_t i=0;i<100;i++){							//  
-		sum += ADCH;
-		_delay_us(20);
+	em4100_sync();
+	adc_capture_start(RFID_IN, 0, ADC_TIMED);				//    
+	adc_next();												//  
+	for (uint8_t i=0;i<RFID_HALF_EDGES;i++){				//  : RF/64, RF/32  RF/16
+		uint8_t entry = adc_next();
+		if(entry == 0 || ADC_LEN(entry) > ADC_TIME(RFID_HALF_MAX*2)){
+			adc_capture_stop();
+			return RFID_NO_KEY;
+		}
+		if(ADC_LEN(entry) < half) half = ADC_LEN(entry);
 	}
-	avg_u = sum / 100;
-	
-	for (uint8_t i=0;i<RFID_BUFFER_SIZE;i++) rfid_buffer[i] = 0;//  
-	
-	for (uint8_t i=0,phase=0,temp,time;i<RFID_BUFFER_SIZE*8;){	//  
-		temp = rfid_in();
-		for(time=5;time<70;time++){
-			_delay_us(10);
-			if(temp != rfid_in()){_delay_us(50); break;}
+	if(half < ADC_TIME(RFID_HALF_MIN) || half > ADC_TIME(RFID_HALF_MAX)){
+		adc_capture_stop();
+		return RFID_NO_KEY;
+	}
+	for (uint8_t i=0,phase=0,temp,len,entry,bit;i<RFID_BUFFER_SIZE*8;){	//  
+		entry = adc_next();
+		temp = (entry & ADC_HIGH) ? 1 : 0;
+		len = ADC_LEN(entry);
+		if(entry == 0 || (len < half - half/2) || (len > half*2 + half/2)){
+			adc_capture_stop();
+			return RFID_NO_KEY;
 		}
-		if((time < 9) || (time > 64)) return RFID_NO_KEY;
-		if(time > 37){											//   
-			if(temp) rfid_buffer[i/8] |= 1<<(i%8);
+		if(len > half + half/2){								//   
+			bit = temp;
 			phase = temp;
-			i++;
 		}else if(phase != temp){
-			if(temp == 0) rfid_buffer[i/8] |= 1<<(i%8);
-			i++;
-		}
-	}
-	for (uint8_t s=0,ones=0,error=0;s<RFID_BUFFER_SIZE*8-54;s++){//  
-		if(rfid_buffer[s/8] & 1<<(s%8)) ones++;
-		else ones = 0;
-		if(ones == 9){											//  
-			ones = 0;
-			s++;
-			for(uint8_t r=0;r<10;r++){							//   
-				uint8_t p = 0;
-				for(uint8_t c=0;c<5;c++) if(rfid_buffer[(r*5+c+s)/8] & 1<<((r*5+c+s)%8)) p ^= 1;				
-				if(p) error = 1;
-			}
-			for(uint8_t c=0;c<4;c++){							//   
-				uint8_t pc = 0;
-				for(uint8_t r=0;r<11;r++) if(rfid_buffer[(r*5+c+s)/8] & 1<<((r*5+c+s)%8)) pc ^= 1;
-				if(pc) error = 1;
-			}
-			if(rfid_buffer[(54+s)/8] & 1<<((54+s)%8)) error = 1;//  -
-			
-			if(error){											//      
-				error = 0;
-				continue;
-			}
-			
-			for(uint8_t i=0;i<8;i++) data[i] = 0;				//   
-			
-			for(uint8_t byte=0;byte<5;byte++){					//  
-				for(uint8_t nibble=0;nibble<2;nibble++){
-					for(uint8_t bit=0;bit<4;bit++)
-						if(rfid_buffer[(byte*10+nibble*5+bit+s)/8] & 1<<((byte*10+nibble*5+bit+s)%8))
-							data[5-byte] |= 0x80>>(nibble*4+bit);
-				}
-			}
-			return RFID_OK;
+			bit = !temp;
+		}else continue;
+		i++;
+		if(em4100_bit(bit, code) != RFID_OK) continue;
+		#if RFID_CONFIRM
+		if(frames++ == 0 || rfid_buffer[0] != code[1] || rfid_buffer[1] != code[2] || rfid_buffer[2] != code[3]
+		   || rfid_buffer[3] != code[4] || rfid_buffer[4] != code[5]){	//    
+			for(uint8_t n=0;n<5;n++) rfid_buffer[n] = code[n+1];
+			frames = 1;
+			continue;
 		}
+		#endif
+		for(uint8_t n=0;n<8;n++) data[n] = code[n];
+		result = RFID_OK;
+		break;
 	}
-	return RFID_PARITY_ERR;
+	adc_capture_stop();
+	return result;
 }
 
 uint8_t rfid_force_read(uint8_t* data)
@@ -15,9 +15,16 @@
 enum enum_rfid{RFID_OK, RFID_NO_KEY, RFID_PARITY_ERR, RFID_MISMATCH};
 
 #define RFID_BUFFER_SIZE 25				//  9-31 
+#define RFID_CONFIRM 0					//1 -      ,   
+
+#define RFID_HALF_EDGES 16				//   
+#define RFID_HALF_MIN 48				//  ,  (RF/16 - 64 )
+#define RFID_HALF_MAX 320				//  ,  (RF/64 - 256 )
 
 void rfid_init(void);
 uint8_t rfid_read(uint8_t* data);
+void em4100_sync(void);
+uint8_t em4100_bit(uint8_t bit, uint8_t* code);
 uint8_t rfid_force_read(uint8_t* data);
 uint8_t rfid_check(uint8_t* data);
 uint8_t rfid_em4305_write(uint8_t* data);
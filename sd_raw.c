@@ -9,7 +9,7 @@
  */
 
 #include <string.h>
-#include <avr/io.h>
+#include "hal.h"
 #include "sd_raw.h"
 
 /**
@@ -60,6 +60,8 @@
 #define CMD_READ_SINGLE_BLOCK 0x11
 /* CMD18: arg0[31:0]: data address, response R1 */
 #define CMD_READ_MULTIPLE_BLOCK 0x12
+/* ACMD23: arg0[22:0]: number of blocks to pre-erase, response R1 */
+#define CMD_SET_WR_BLK_ERASE_COUNT 0x17
 /* CMD24: arg0[31:0]: data address, response R1 */
 #define CMD_WRITE_SINGLE_BLOCK 0x18
 /* CMD25: arg0[31:0]: data address, response R1 */
@@ -153,6 +155,14 @@ static offset_t raw_block_address;
 /* flag to remember if raw_block was written to the card */
 static uint8_t raw_block_written;
 #endif
+/* offset of the next block an open multiple block read delivers */
+static offset_t raw_stream_address;
+#if SD_RAW_WRITE_SUPPORT
+/* offset of the next block an open multiple block write expects */
+static offset_t raw_write_address;
+/* flag to remember if raw_block holds streamed data not yet sent */
+static uint8_t raw_block_pending;
+#endif
 #endif
 
 /* card type state */
@@ -161,7 +171,13 @@ static uint8_t sd_raw_card_type;
 /* private helper functions */
 static void sd_raw_send_byte(uint8_t b);
 static uint8_t sd_raw_rec_byte();
+static void sd_raw_send_block(const uint8_t* buffer);
+static void sd_raw_rec_block(uint8_t* buffer, uint16_t length);
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+static uint8_t sd_raw_stream_stop();
+#if SD_RAW_WRITE_SUPPORT
+static uint8_t sd_raw_stream_send(uint32_t count);
+#endif
 
 /**
  * \ingroup sd_raw
@@ -320,6 +336,11 @@ uint8_t sd_raw_init()
 #if !SD_RAW_SAVE_RAM
     /* the first block is likely to be accessed first, so precache it here */
     raw_block_address = (offset_t) -1;
+    raw_stream_address = (offset_t) -1;
+#if SD_RAW_WRITE_SUPPORT
+    raw_write_address = (offset_t) -1;
+    raw_block_pending = 0;
+#endif
 #if SD_RAW_WRITE_BUFFERING
     raw_block_written = 1;
 #endif
@@ -386,6 +407,55 @@ uint8_t sd_raw_rec_byte()
     return SPDR;
 }
 
+/**
+ * \ingroup sd_raw
+ * Sends a 512 byte data block to the memory card.
+ *
+ * The next byte is fetched while the previous one is shifted out and
+ * written to SPDR as soon as the transfer completes, so the bytes follow
+ * each other without the call and flag clearing overhead of
+ * sd_raw_send_byte().
+ *
+ * \param[in] buffer The block to send.
+ * \see sd_raw_rec_block
+ */
+void sd_raw_send_block(const uint8_t* buffer)
+{
+    SPDR = *buffer++;
+    for(uint16_t i = 1; i < 512; ++i)
+    {
+        uint8_t b = *buffer++;
+        while(!(SPSR & (1 << SPIF)));
+        SPDR = b;
+    }
+    while(!(SPSR & (1 << SPIF)));
+}
+
+/**
+ * \ingroup sd_raw
+ * Receives a number of bytes from the memory card.
+ *
+ * The next byte is requested right after the previous one arrived, its
+ * transfer overlaps with storing the previous byte.
+ *
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] length The number of bytes to receive, at least one.
+ * \see sd_raw_send_block
+ */
+void sd_raw_rec_block(uint8_t* buffer, uint16_t length)
+{
+    SPDR = 0xff;
+    while(--length)
+    {
+        while(!(SPSR & (1 << SPIF)));
+        uint8_t b = SPDR;
+        SPDR = 0xff;
+        *buffer++ = b;
+    }
+    while(!(SPSR & (1 << SPIF)));
+    *buffer = SPDR;
+}
+
 /**
  * \ingroup sd_raw
  * Send a command to the memory card which responses with a R1 response (and possibly others).
@@ -464,6 +534,8 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
             if(!sd_raw_sync())
                 return 0;
 #endif
+            if(!sd_raw_stream_stop())
+                return 0;
 
             /* address card */
             select_card();
@@ -493,12 +565,12 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
             }
 #else
             /* read byte block */
-            uint8_t* cache = raw_block;
-            for(uint16_t i = 0; i < 512; ++i)
-                *cache++ = sd_raw_rec_byte();
+            sd_raw_rec_block(raw_block, 512);
             raw_block_address = block_address;
 
-            memcpy(buffer, raw_block + block_offset, read_length);
+            /* sd_raw_write_stream() loads the cache itself this way */
+            if(buffer != raw_block + block_offset)
+                memcpy(buffer, raw_block + block_offset, read_length);
             buffer += read_length;
 #endif
 
@@ -516,7 +588,8 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
         else
         {
             /* use cached data */
-            memcpy(buffer, raw_block + block_offset, read_length);
+            if(buffer != raw_block + block_offset)
+                memcpy(buffer, raw_block + block_offset, read_length);
             buffer += read_length;
         }
 #endif
@@ -528,6 +601,161 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
     return 1;
 }
 
+/**
+ * \ingroup sd_raw
+ * Reads raw data from the card, keeping a multiple block read open.
+ *
+ * Works like sd_raw_read(), but blocks which are not cached are fetched
+ * with CMD18 (READ_MULTIPLE_BLOCK). The transmission is left open, so a
+ * following call which continues at the next block receives it without
+ * sending a new command. Any other card access stops the transmission.
+ *
+ * Use this for sequential access like reading a file from start to end.
+ *
+ * \param[in] offset The offset from which to read.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] length The number of bytes to read.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_read
+ */
+uint8_t sd_raw_read_stream(offset_t offset, uint8_t* buffer, uintptr_t length)
+{
+#if SD_RAW_SAVE_RAM
+    return sd_raw_read(offset, buffer, length);
+#else
+    offset_t block_address;
+    uint16_t block_offset;
+    uint16_t read_length;
+    while(length > 0)
+    {
+        /* determine byte count to read at once */
+        block_offset = offset & 0x01ff;
+        block_address = offset - block_offset;
+        read_length = 512 - block_offset; /* read up to block border */
+        if(read_length > length)
+            read_length = length;
+
+        /* check if the requested data is cached */
+        if(block_address != raw_block_address)
+        {
+#if SD_RAW_WRITE_BUFFERING
+            /* a dirty cached block is written back first, which stops
+             * the transmission, a clean one is simply replaced
+             */
+            if(!sd_raw_sync())
+                return 0;
+#endif
+#if SD_RAW_WRITE_SUPPORT
+            if(block_address != raw_stream_address || raw_block_pending)
+#else
+            if(block_address != raw_stream_address)
+#endif
+            {
+                if(!sd_raw_stream_stop())
+                    return 0;
+
+                /* address card */
+                select_card();
+
+                /* send multiple block request */
+#if SD_RAW_SDHC
+                if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+                if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, block_address))
+#endif
+                {
+                    unselect_card();
+                    return 0;
+                }
+            }
+
+            /* wait for data block (start byte 0xfe) */
+            while(sd_raw_rec_byte() != 0xfe);
+
+            /* read byte block */
+            sd_raw_rec_block(raw_block, 512);
+            raw_block_address = block_address;
+            raw_stream_address = block_address + 512;
+
+            /* read crc16 */
+            sd_raw_rec_byte();
+            sd_raw_rec_byte();
+        }
+
+        memcpy(buffer, raw_block + block_offset, read_length);
+        buffer += read_length;
+        length -= read_length;
+        offset += read_length;
+    }
+
+    return 1;
+#endif
+}
+
+/**
+ * \ingroup sd_raw
+ * Sends pending streamed data and stops open multiple block transfers.
+ *
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_stream_stop()
+{
+#if !SD_RAW_SAVE_RAM
+#if SD_RAW_WRITE_SUPPORT
+    /* send streamed data still held in raw_block */
+    if(raw_block_pending && !sd_raw_stream_send(1))
+        return 0;
+
+    if(raw_write_address != (offset_t) -1)
+    {
+        raw_write_address = (offset_t) -1;
+
+        /* send stop token */
+        sd_raw_send_byte(0xfd);
+        sd_raw_rec_byte();
+
+        /* wait while card is busy */
+        while(sd_raw_rec_byte() != 0xff);
+
+        /* deaddress card */
+        unselect_card();
+
+        /* let card some time to finish */
+        sd_raw_rec_byte();
+    }
+#endif
+
+    if(raw_stream_address != (offset_t) -1)
+    {
+        /* finish a block left open by sd_raw_read_interval_stream() */
+        if(raw_stream_address & 0x01ff)
+        {
+            for(uint16_t i = raw_stream_address & 0x01ff; i < 512; ++i)
+                sd_raw_rec_byte();
+
+            /* read crc16 */
+            sd_raw_rec_byte();
+            sd_raw_rec_byte();
+        }
+
+        raw_stream_address = (offset_t) -1;
+
+        sd_raw_send_command(CMD_STOP_TRANSMISSION, 0);
+
+        /* wait while card is busy */
+        while(sd_raw_rec_byte() != 0xff);
+
+        /* deaddress card */
+        unselect_card();
+
+        /* let card some time to finish */
+        sd_raw_rec_byte();
+    }
+#endif
+
+    return 1;
+}
+
 /**
  * \ingroup sd_raw
  * Continuously reads units of \c interval bytes and calls a callback function.
@@ -578,7 +806,6 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 
     uint16_t block_offset;
     uint16_t read_length;
-    uint8_t* buffer_cur;
     uint8_t finished = 0;
     do
     {
@@ -610,9 +837,7 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
             if(read_length < interval || length < interval)
                 break;
 
-            buffer_cur = buffer;
-            for(uint16_t i = 0; i < interval; ++i)
-                *buffer_cur++ = sd_raw_rec_byte();
+            sd_raw_rec_block(buffer, interval);
 
             if(!callback(buffer, offset + (512 - read_length), p))
             {
@@ -650,6 +875,133 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 #endif
 }
 
+/**
+ * \ingroup sd_raw
+ * Continuously reads units of \c interval bytes with a multiple block
+ * read and calls a callback function.
+ *
+ * Works like sd_raw_read_interval(), but the data is received straight
+ * into \c buffer instead of passing the block cache. The cached block is
+ * neither replaced nor written back, for the block it holds its content
+ * is used instead of the card's. Units may cross block borders.
+ *
+ * Use this for scans over large areas like the FAT. The transmission is
+ * left open like with sd_raw_read_stream(), also in the middle of a
+ * block, so a following call starting at the byte where this one
+ * stopped continues without a new command.
+ *
+ * \note Within the callback function, you can not start another read or
+ *       write operation.
+ *
+ * \param[in] offset Offset from which to start reading.
+ * \param[in] buffer Pointer to a buffer which is at least interval bytes in size.
+ * \param[in] interval Number of bytes to read before calling the callback function.
+ * \param[in] length Number of bytes to read altogether.
+ * \param[in] callback The function to call every interval bytes.
+ * \param[in] p An opaque pointer directly passed to the callback function.
+ * \returns 0 on failure, 1 on success
+ * \see sd_raw_read_interval, sd_raw_read_stream
+ */
+uint8_t sd_raw_read_interval_stream(offset_t offset, uint8_t* buffer, uintptr_t interval, uintptr_t length, sd_raw_read_interval_handler_t callback, void* p)
+{
+#if SD_RAW_SAVE_RAM
+    return sd_raw_read_interval(offset, buffer, interval, length, callback, p);
+#else
+    if(!buffer || interval == 0 || length < interval || !callback)
+        return 0;
+
+    uint16_t block_offset = offset & 0x01ff;
+    offset_t block_address = offset - block_offset;
+
+    /* continue within the block the last call stopped in */
+    uint8_t in_block = block_offset && offset == raw_stream_address;
+
+#if SD_RAW_WRITE_SUPPORT
+    if(raw_block_pending || (block_address != raw_stream_address && !in_block))
+#else
+    if(block_address != raw_stream_address && !in_block)
+#endif
+    {
+        in_block = 0;
+
+        if(!sd_raw_stream_stop())
+            return 0;
+
+        /* address card */
+        select_card();
+
+        /* send multiple block request */
+#if SD_RAW_SDHC
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+        if(sd_raw_send_command(CMD_READ_MULTIPLE_BLOCK, block_address))
+#endif
+        {
+            unselect_card();
+            return 0;
+        }
+    }
+
+    uintptr_t filled = 0;
+    uint8_t finished = 0;
+    while(!finished)
+    {
+        if(!in_block)
+        {
+            /* wait for data block (start byte 0xfe) */
+            while(sd_raw_rec_byte() != 0xfe);
+
+            /* read up to the data of interest */
+            for(uint16_t i = 0; i < block_offset; ++i)
+                sd_raw_rec_byte();
+        }
+        in_block = 0;
+
+        while(block_offset < 512 && !finished)
+        {
+            uint16_t read_length = 512 - block_offset;
+            if(read_length > interval - filled)
+                read_length = interval - filled;
+
+            sd_raw_rec_block(buffer + filled, read_length);
+            if(block_address == raw_block_address)
+            {
+                /* the cached block may not be written back yet */
+                memcpy(buffer + filled, raw_block + block_offset, read_length);
+            }
+            block_offset += read_length;
+            filled += read_length;
+
+            if(filled == interval)
+            {
+                filled = 0;
+                length -= interval;
+                if(!callback(buffer, offset, p) || length < interval)
+                    finished = 1;
+                offset += interval;
+            }
+        }
+
+        if(block_offset < 512)
+        {
+            /* the rest of the block is received by the next call */
+            raw_stream_address = block_address + block_offset;
+            break;
+        }
+
+        /* read crc16 */
+        sd_raw_rec_byte();
+        sd_raw_rec_byte();
+
+        block_offset = 0;
+        block_address += 512;
+        raw_stream_address = block_address;
+    }
+
+    return 1;
+#endif
+}
+
 #if DOXYGEN || SD_RAW_WRITE_SUPPORT
 /**
  * \ingroup sd_raw
@@ -670,6 +1022,9 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
     if(sd_raw_locked())
         return 0;
 
+    if(!sd_raw_stream_stop())
+        return 0;
+
     offset_t block_address;
     uint16_t block_offset;
     uint16_t write_length;
@@ -730,9 +1085,7 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
         sd_raw_send_byte(0xfe);
 
         /* write byte block */
-        uint8_t* cache = raw_block;
-        for(uint16_t i = 0; i < 512; ++i)
-            sd_raw_send_byte(*cache++);
+        sd_raw_send_block(raw_block);
 
         /* write dummy crc16 */
         sd_raw_send_byte(0xff);
@@ -758,6 +1111,159 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
 }
 #endif
 
+#if DOXYGEN || SD_RAW_WRITE_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Writes raw data to the card using a multiple block write.
+ *
+ * This is meant for appending data. Blocks are collected in the block
+ * cache and sent with CMD25 (WRITE_MULTIPLE_BLOCK) as soon as they are
+ * complete. The transmission is left open, so consecutive calls write
+ * the following blocks without sending a new command. On SD cards the
+ * number of blocks known to follow is announced with ACMD23 first, which
+ * lets the card pre-erase them.
+ *
+ * A partially written block is sent by the next access to the card or by
+ * sd_raw_sync().
+ *
+ * \note A block which is entered at its start is not read from the card,
+ *       the bytes behind the written data are zero.
+ *
+ * \param[in] offset The offset where to start writing.
+ * \param[in] buffer The buffer containing the data to be written.
+ * \param[in] length The number of bytes to write.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_write, sd_raw_sync
+ */
+uint8_t sd_raw_write_stream(offset_t offset, const uint8_t* buffer, uintptr_t length)
+{
+    if(sd_raw_locked())
+        return 0;
+
+    offset_t block_address;
+    uint16_t block_offset;
+    uint16_t write_length;
+    while(length > 0)
+    {
+        /* determine byte count to write at once */
+        block_offset = offset & 0x01ff;
+        block_address = offset - block_offset;
+        write_length = 512 - block_offset; /* write up to block border */
+        if(write_length > length)
+            write_length = length;
+
+        if(block_address != raw_block_address)
+        {
+            /* send the previous block, the transmission stays open */
+            if(raw_block_pending && !sd_raw_stream_send(1))
+                return 0;
+#if SD_RAW_WRITE_BUFFERING
+            if(!raw_block_written && !sd_raw_sync())
+                return 0;
+#endif
+
+            if(block_offset)
+            {
+                /* keep the data in front of the write position, the
+                 * block is read straight into the cache
+                 */
+                if(!sd_raw_read(block_address, raw_block, sizeof(raw_block)))
+                    return 0;
+            }
+            else
+            {
+                memset(raw_block, 0, sizeof(raw_block));
+            }
+            raw_block_address = block_address;
+        }
+
+        memcpy(raw_block + block_offset, buffer, write_length);
+        raw_block_pending = 1;
+
+        buffer += write_length;
+        offset += write_length;
+        length -= write_length;
+
+        /* send completed blocks right away */
+        if(block_offset + write_length == 512)
+        {
+            if(!sd_raw_stream_send(1 + (length + 511) / 512))
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Sends raw_block as the next block of a multiple block write.
+ *
+ * Starts a new transmission if raw_block does not continue the open one.
+ *
+ * \param[in] count The number of blocks to announce for pre-erasing.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_stream_send(uint32_t count)
+{
+    raw_block_pending = 0;
+#if SD_RAW_WRITE_BUFFERING
+    /* the cached block reaches the card with this transfer */
+    raw_block_written = 1;
+#endif
+
+    if(raw_write_address != raw_block_address)
+    {
+        if(!sd_raw_stream_stop())
+            return 0;
+
+        /* address card */
+        select_card();
+
+        if(sd_raw_card_type & ((1 << SD_RAW_SPEC_1) | (1 << SD_RAW_SPEC_2)))
+        {
+            sd_raw_send_command(CMD_APP, 0);
+            sd_raw_send_command(CMD_SET_WR_BLK_ERASE_COUNT, count);
+        }
+
+        /* send multiple block request */
+#if SD_RAW_SDHC
+        if(sd_raw_send_command(CMD_WRITE_MULTIPLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? raw_block_address / 512 : raw_block_address)))
+#else
+        if(sd_raw_send_command(CMD_WRITE_MULTIPLE_BLOCK, raw_block_address))
+#endif
+        {
+            unselect_card();
+            return 0;
+        }
+        raw_write_address = raw_block_address;
+    }
+
+    /* send start byte */
+    sd_raw_send_byte(0xfc);
+
+    /* write byte block */
+    sd_raw_send_block(raw_block);
+
+    /* write dummy crc16 */
+    sd_raw_send_byte(0xff);
+    sd_raw_send_byte(0xff);
+
+    /* check data response */
+    if((sd_raw_rec_byte() & 0x1f) != DR_STATUS_ACCEPTED)
+    {
+        sd_raw_stream_stop();
+        return 0;
+    }
+
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+
+    raw_write_address += 512;
+    return 1;
+}
+#endif
+
 #if DOXYGEN || SD_RAW_WRITE_SUPPORT
 /**
  * \ingroup sd_raw
@@ -814,6 +1320,10 @@ uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length
  * \ingroup sd_raw
  * Writes the write buffer's content to the card.
  *
+ * Streamed writes are completed as well. With nothing left to write,
+ * the function returns at once and an open multiple block read stays
+ * open.
+ *
  * \note When write buffering is enabled, you should
  *       call this function before disconnecting the
  *       card to ensure all remaining data has been
@@ -824,6 +1334,15 @@ uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length
  */
 uint8_t sd_raw_sync()
 {
+#if SD_RAW_WRITE_BUFFERING
+    /* with nothing to write, an open multiple block read goes on */
+    if(raw_block_written && !raw_block_pending && raw_write_address == (offset_t) -1)
+        return 1;
+#endif
+
+    if(!sd_raw_stream_stop())
+        return 0;
+
 #if SD_RAW_WRITE_BUFFERING
     if(raw_block_written)
         return 1;
@@ -857,6 +1376,9 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
 
     memset(info, 0, sizeof(*info));
 
+    if(!sd_raw_stream_stop())
+        return 0;
+
     select_card();
 
     /* read cid register */
@@ -41,9 +41,17 @@ extern "C"
  *
  * Set to 1 to buffer write accesses, set to 0 to disable it.
  *
+ * With buffering, the block cache is written back only when another
+ * block is accessed or sd_raw_sync() is called. Consecutive updates of
+ * one block then reach the card once, but the cache holds a single
+ * block, so updates alternating between two blocks are written back
+ * on every switch.
+ *
  * \note This option has no effect when SD_RAW_WRITE_SUPPORT is 0.
  */
-#define SD_RAW_WRITE_BUFFERING 0
+#ifndef SD_RAW_WRITE_BUFFERING
+#define SD_RAW_WRITE_BUFFERING 1
+#endif
 
 /**
  * \ingroup sd_raw_config
@@ -4,9 +4,7 @@
  * Created: 15.02.2016 16:01:25
  *  Author: GunMan
  */ 
-#include <avr/io.h>
-#include <avr/pgmspace.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "sound.h"
 
 //    
@@ -19,10 +17,28 @@ void delay_note (uint16_t delay)
 	for (uint16_t i=0;i<delay;i++) _delay_ms(1);
 }
 
+#define SOUND_TCCR1B ((1<<WGM12)|(1<<CS10))//CTC mode, no prescaling
+
+static uint8_t timer1_users;
+
+void timer1_claim(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+		if(timer1_users++ == 0) TCCR1B = 1<<CS11;	//normal mode, clk/8
+	}
+}
+
+void timer1_release(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+		if(timer1_users && --timer1_users == 0) TCCR1B = SOUND_TCCR1B;
+	}
+}
+
 void sound_init()
 {
 	TCCR1A = 0x00;
-	TCCR1B = (1<<WGM12)|(1<<CS10);//CTC mode, no prescaling
+	TCCR1B = SOUND_TCCR1B;
 	
 	SOUND_DDR |= 1<<SOUND_OUT;
 	SOUND_PORT &= ~(1<<SOUND_OUT);
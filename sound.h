@@ -70,6 +70,12 @@
 #define SOUND_DDR	DDRB
 #define SOUND_OUT	1
 
+//Timer1     CTC.      1-Wire
+//       0,5 ,   
+void timer1_claim(void);
+
+void timer1_release(void);
+
 void sound_init(void);
 
 void sound_play(const uint8_t* melody);
\ No newline at end of file
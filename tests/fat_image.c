@@ -0,0 +1,242 @@
+/*
+ * fat_image.c
+ *
+ * Created: 18.10.2026 18:14:52
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sd_card.h"
+#include "fat_image.h"
+
+#define FAT_IMAGE_ROOT_ENTRIES 512						//FAT16
+#define FAT_IMAGE_RESERVED_16 1
+#define FAT_IMAGE_RESERVED_32 32
+
+struct fat_image_stats fat_image_stats;
+
+static struct partition_struct* fat_image_partition;
+static struct fat_image* fat_image_mounted;
+
+static void count(offset_t offset, uintptr_t length)
+{
+	fat_image_stats.reads++;
+	fat_image_stats.read_bytes += length;
+	if(offset >= fat_image_mounted->fat_offset && offset < fat_image_mounted->fat_offset + 2 * fat_image_mounted->fat_sectors * 512)
+		fat_image_stats.fat_reads++;
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return p[0] | p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t fat_image_entry(const struct fat_image* image, uint32_t cluster)
+{
+	const uint8_t* p = image->data + image->fat_offset;
+	if(image->fat32) return get32(p + cluster * 4) & 0x0FFFFFFF;
+	return p[cluster * 2] | p[cluster * 2 + 1] << 8;
+}
+
+static void fat_image_set(struct fat_image* image, uint32_t cluster, uint32_t value)
+{
+	for(uint8_t copy=0;copy<2;copy++){
+		uint8_t* p = image->data + image->fat_offset + copy * image->fat_sectors * 512;
+		if(image->fat32) put32(p + cluster * 4, value);
+		else put16(p + cluster * 2, value);
+	}
+}
+
+void fat_image_format(struct fat_image* image, uint32_t blocks, uint8_t fat32)
+{
+	uint32_t reserved = fat32 ? FAT_IMAGE_RESERVED_32 : FAT_IMAGE_RESERVED_16;
+	uint32_t root_sectors = fat32 ? 0 : FAT_IMAGE_ROOT_ENTRIES * 32 / 512;
+	uint8_t* boot;
+
+	memset(image, 0, sizeof(*image));
+	image->data = calloc(blocks, 512);
+	image->blocks = blocks;
+	image->fat32 = fat32;
+	image->fat_sectors = ((blocks - reserved - root_sectors) + 2) * (fat32 ? 4 : 2) / 512 + 1;
+	image->clusters = blocks - reserved - root_sectors - 2 * image->fat_sectors;
+	image->fat_offset = reserved * 512;
+	image->root_offset = image->fat_offset + 2 * image->fat_sectors * 512;
+	image->cluster_offset = image->root_offset + root_sectors * 512;
+	image->next = fat32 ? 3 : 2;						//FAT32 root directory in cluster 2
+
+	boot = image->data;
+	boot[0] = 0xEB; boot[1] = 0x58; boot[2] = 0x90;
+	memcpy(boot + 3, "MSDOS5.0", 8);
+	put16(boot + 0x0B, 512);
+	boot[0x0D] = 1;										//sectors per cluster
+	put16(boot + 0x0E, reserved);
+	boot[0x10] = 2;										//FAT copies
+	put16(boot + 0x11, fat32 ? 0 : FAT_IMAGE_ROOT_ENTRIES);
+	boot[0x15] = 0xF8;
+	put32(boot + 0x20, blocks);
+	if(fat32){
+		put32(boot + 0x24, image->fat_sectors);
+		put32(boot + 0x2C, 2);							//root directory cluster
+		put16(boot + 0x30, 1);							//FSInfo sector
+		put16(boot + 0x32, 6);							//backup boot sector
+	}else put16(boot + 0x16, image->fat_sectors);
+	boot[510] = 0x55;
+	boot[511] = 0xAA;
+
+	fat_image_set(image, 0, fat32 ? 0x0FFFFFF8 : 0xFFF8);
+	fat_image_set(image, 1, fat32 ? 0x0FFFFFFF : 0xFFFF);
+	if(fat32) fat_image_set(image, 2, 0x0FFFFFFF);
+	fat_image_write_fsinfo(image);
+}
+
+void fat_image_release(struct fat_image* image)
+{
+	free(image->data);
+	image->data = 0;
+}
+
+static void fat_image_short_name(const char* name, uint8_t* entry)
+{
+	const char* dot = strchr(name, '.');
+	memset(entry, ' ', 11);
+	for(uint8_t i=0;i<8 && name[i] && name + i != dot;i++) entry[i] = name[i] >= 'a' && name[i] <= 'z' ? name[i] - 'a' + 'A' : name[i];
+	for(uint8_t i=0;dot && i<3 && dot[i + 1];i++) entry[8 + i] = dot[i + 1] >= 'a' && dot[i + 1] <= 'z' ? dot[i + 1] - 'a' + 'A' : dot[i + 1];
+}
+
+uint32_t fat_image_add_file(struct fat_image* image, const char* name, const uint8_t* data, uint32_t size, uint32_t run, uint32_t gap)
+{
+	uint32_t count = (size + 511) / 512, first = count ? image->next : 0;
+	uint8_t* entry = image->data + (image->fat32 ? image->cluster_offset : image->root_offset) + image->root_used++ * 32;
+
+	for(uint32_t i=0;i<count;i++){
+		uint32_t cluster = image->next;
+		uint32_t length = size - i * 512 < 512 ? size - i * 512 : 512;
+		image->next++;
+		if(run && (i + 1) % run == 0 && i + 1 < count) image->next += gap;
+		fat_image_set(image, cluster, i + 1 < count ? image->next : (image->fat32 ? 0x0FFFFFFF : 0xFFFF));
+		if(data) memcpy(image->data + image->cluster_offset + (cluster - 2) * 512, data + i * 512, length);
+	}
+
+	fat_image_short_name(name, entry);
+	entry[11] = 0x20;									//archive
+	entry[12] = 0x18;									//name and extension in lower case
+	put16(entry + 20, first >> 16);
+	put16(entry + 26, first);
+	put32(entry + 28, size);
+	fat_image_write_fsinfo(image);
+	return first;
+}
+
+uint32_t fat_image_free_count(const struct fat_image* image)
+{
+	uint32_t count = 0;
+	for(uint32_t cluster=2;cluster<image->clusters + 2;cluster++) count += fat_image_entry(image, cluster) == 0;
+	return count;
+}
+
+void fat_image_write_fsinfo(struct fat_image* image)
+{
+	uint8_t* fsinfo = image->data + 512;
+	if(!image->fat32) return;
+	put32(fsinfo, 0x41615252);
+	put32(fsinfo + 484, 0x61417272);
+	put32(fsinfo + 488, fat_image_free_count(image));
+	put32(fsinfo + 492, image->next);
+	put32(fsinfo + 508, 0xAA550000);
+}
+
+static uint8_t count_read(offset_t offset, uint8_t* buffer, uintptr_t length)
+{
+	count(offset, length);
+	return sd_raw_read(offset, buffer, length);
+}
+
+static uint8_t count_read_stream(offset_t offset, uint8_t* buffer, uintptr_t length)
+{
+	count(offset, length);
+	return sd_raw_read_stream(offset, buffer, length);
+}
+
+static uint8_t count_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interval, uintptr_t length, sd_raw_read_interval_handler_t callback, void* p)
+{
+	count(offset, length);
+	return sd_raw_read_interval(offset, buffer, interval, length, callback, p);
+}
+
+static uint8_t count_read_interval_stream(offset_t offset, uint8_t* buffer, uintptr_t interval, uintptr_t length, sd_raw_read_interval_handler_t callback, void* p)
+{
+	count(offset, length);
+	return sd_raw_read_interval_stream(offset, buffer, interval, length, callback, p);
+}
+
+static uint8_t count_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
+{
+	fat_image_stats.writes++;
+	return sd_raw_write(offset, buffer, length);
+}
+
+static uint8_t count_write_stream(offset_t offset, const uint8_t* buffer, uintptr_t length)
+{
+	fat_image_stats.writes++;
+	return sd_raw_write_stream(offset, buffer, length);
+}
+
+static uint8_t count_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length, sd_raw_write_interval_handler_t callback, void* p)
+{
+	fat_image_stats.writes++;
+	return sd_raw_write_interval(offset, buffer, length, callback, p);
+}
+
+struct fat_fs_struct* fat_image_mount(struct fat_image* image, struct fat_dir_struct** root)
+{
+	struct fat_fs_struct* fs;
+	struct fat_dir_entry_struct entry;
+
+	sim_reset();
+	fat_image_mounted = image;
+	sd_card_attach(image->data, image->blocks);
+	if(!sd_raw_init()) return 0;
+	fat_image_partition = partition_open(count_read, count_read_stream, count_read_interval, count_read_interval_stream,
+										 count_write, count_write_stream, count_write_interval, -1);
+	if(!fat_image_partition) return 0;
+	fs = fat_open(fat_image_partition);
+	if(!fs){
+		partition_close(fat_image_partition);
+		return 0;
+	}
+	fat_get_dir_entry_of_path(fs, "/", &entry);
+	*root = fat_open_dir(fs, &entry);
+	memset(&fat_image_stats, 0, sizeof(fat_image_stats));
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	return fs;
+}
+
+void fat_image_unmount(struct fat_fs_struct* fs, struct fat_dir_struct* root)
+{
+	fat_close_dir(root);
+	fat_close(fs);
+	sd_raw_sync();
+	partition_close(fat_image_partition);
+}
+
+struct fat_file_struct* fat_image_open(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name, uint8_t create)
+{
+	struct fat_dir_entry_struct entry;
+
+	if(create){
+		if(!fat_create_file(dd, name, &entry)) return 0;
+	}else if(!fat_find_dir_entry(dd, name, &entry)) return 0;
+	return fat_open_file(fs, &entry);
+}
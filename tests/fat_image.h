@@ -0,0 +1,53 @@
+/*
+ * fat_image.h
+ *
+ * Created: 18.10.2026 18:10:27
+ */
+#pragma once
+
+//FAT16 and FAT32 volumes without MBR built in memory for the filesystem
+//tests, one sector per cluster. Files go to the root directory with an
+//8.3 name and may be spread over the disk with free gaps between their
+//clusters. The volume is mounted through sd_raw.c and the SPI card model.
+
+#include <stdint.h>
+#include "sd_raw.h"
+#include "partition.h"
+#include "fat.h"
+
+struct fat_image{
+	uint8_t* data;
+	uint32_t blocks;
+	uint8_t fat32;
+	uint32_t fat_offset;								//bytes, first FAT
+	uint32_t fat_sectors;								//per FAT
+	uint32_t root_offset;								//bytes, FAT16 root directory
+	uint32_t cluster_offset;							//bytes, cluster 2
+	uint32_t clusters;									//data clusters
+	uint32_t next;										//first cluster the next file gets
+	uint16_t root_used;									//root directory entries used
+};
+
+//device calls the filesystem made, counted by the mount
+struct fat_image_stats{
+	uint32_t reads;
+	uint32_t read_bytes;
+	uint32_t fat_reads;									//reads inside the FATs
+	uint32_t writes;
+};
+
+extern struct fat_image_stats fat_image_stats;
+
+void fat_image_format(struct fat_image* image, uint32_t blocks, uint8_t fat32);
+void fat_image_release(struct fat_image* image);
+uint32_t fat_image_entry(const struct fat_image* image, uint32_t cluster);
+//returns the first cluster, after every run clusters gap clusters stay free
+//(run 0 - contiguous)
+uint32_t fat_image_add_file(struct fat_image* image, const char* name, const uint8_t* data, uint32_t size, uint32_t run, uint32_t gap);
+uint32_t fat_image_free_count(const struct fat_image* image);	//FAT scan
+void fat_image_write_fsinfo(struct fat_image* image);			//FAT32: free count and next free hint
+
+struct fat_fs_struct* fat_image_mount(struct fat_image* image, struct fat_dir_struct** root);
+void fat_image_unmount(struct fat_fs_struct* fs, struct fat_dir_struct* root);
+//opens a file of the directory by name, create 1 - creates it first
+struct fat_file_struct* fat_image_open(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name, uint8_t create);
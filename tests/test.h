@@ -0,0 +1,33 @@
+/*
+ * test.h
+ *
+ * Created: 17.10.2026 23:20:05
+ */
+#pragma once
+
+//Host tests are plain programs, a failed check prints itself and the test
+//exits with the number of failures.
+
+#include <stdio.h>
+
+static unsigned test_failures;
+
+#define CHECK(cond) do{ \
+	if(!(cond)){ \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} \
+}while(0)
+
+#define CHECK_RANGE(value, min, max) do{ \
+	double test_v = (value); \
+	if(test_v < (min) || test_v > (max)){ \
+		printf("%s:%d: %s = %g, expected %g..%g\n", __FILE__, __LINE__, #value, test_v, (double)(min), (double)(max)); \
+		test_failures++; \
+	} \
+}while(0)
+
+#define TEST_END() do{ \
+	if(test_failures) printf("%u check(s) failed\n", test_failures); \
+	return test_failures != 0; \
+}while(0)
@@ -0,0 +1,72 @@
+/*
+ * test_cache.c
+ *
+ * Created: 19.10.2026 16:48:23
+ */
+//Card writes of the log flush in main.c, built with and without
+//SD_RAW_WRITE_BUFFERING: SESSIONS times log.bin is looked up and opened,
+//RECORDS journal records are appended, the file is closed and the cache
+//synced. Also counts the writes of one record.
+
+#include <string.h>
+#include "sd_card.h"
+#include "fat_image.h"
+#include "journal.h"
+#include "test.h"
+
+#define SESSIONS 25
+#define RECORDS 4
+
+static struct fat_fs_struct* fs;
+static struct fat_dir_struct* dd;
+
+static void flush(uint8_t records)
+{
+	struct fat_dir_entry_struct entry;
+	struct journal_record_struct record;
+	struct fat_file_struct* fd = 0;
+
+	memset(&record, 0, sizeof(record));
+	record.key = 1;
+	record.count = 1;
+	if(fat_find_dir_entry(dd, "log.bin", &entry)) fd = fat_open_file(fs, &entry);
+	CHECK(fd != 0);
+	if(!fd) return;
+	journal_open(fd);
+	for(uint8_t i=0;i<records;i++){
+		record.code[0] = i;
+		CHECK(journal_append(fd, &record));
+	}
+	fat_close_file(fd);
+	CHECK(sd_raw_sync());
+}
+
+int main(void)
+{
+	struct fat_image image;
+
+	fat_image_format(&image, 6000, 0);
+	fat_image_add_file(&image, "log.bin", 0, 0, 0, 0);
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) TEST_END();
+
+	for(uint8_t i=0;i<SESSIONS;i++) flush(RECORDS);
+	uint32_t written = sd_card_stats.blocks_written;
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	flush(1);
+	printf("SD_RAW_WRITE_BUFFERING %u: %u flushes of %u records %u blocks written, one record %u blocks\n",
+		   SD_RAW_WRITE_BUFFERING, SESSIONS, RECORDS, written, sd_card_stats.blocks_written);
+
+#if SD_RAW_WRITE_BUFFERING
+	CHECK(written <= SESSIONS * 3);						//data block and directory entry, the FAT now and then
+	CHECK(sd_card_stats.blocks_written == 2);
+#endif
+
+	struct fat_dir_entry_struct entry;
+	CHECK(fat_find_dir_entry(dd, "log.bin", &entry));
+	CHECK(entry.file_size == (SESSIONS * RECORDS + 1) * JOURNAL_RECORD_SIZE);
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+	TEST_END();
+}
@@ -0,0 +1,90 @@
+/*
+ * test_chain.c
+ *
+ * Created: 18.10.2026 18:52:30
+ */
+//Cluster chain lookups of fat.c, built once per FAT_EXTENT_COUNT. Random
+//seeks into a contiguous and into a fragmented file must read what a plain
+//walk of the chain finds: every cluster of the files holds its own index,
+//so a wrong cluster shows up in the data. The FAT reads are counted.
+
+#include <stdlib.h>
+#include <string.h>
+#include "fat_image.h"
+#include "test.h"
+
+#define FILE_CLUSTERS 60
+#define SEEKS 300
+
+static uint8_t content[FILE_CLUSTERS * 512];
+
+static uint32_t seek_reads(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name)	//FAT reads of SEEKS random reads
+{
+	struct fat_file_struct* fd = fat_image_open(fs, dd, name, 0);
+	uint8_t buffer[16];
+	uint32_t start = fat_image_stats.fat_reads;
+
+	CHECK(fd != 0);
+	if(!fd) return 0;
+	for(uint16_t i=0;i<SEEKS;i++){
+		int32_t offset = rand() % (sizeof(content) - sizeof(buffer));
+		CHECK(fat_seek_file(fd, &offset, FAT_SEEK_SET));
+		CHECK(fat_read_file(fd, buffer, sizeof(buffer)) == sizeof(buffer));
+		CHECK(!memcmp(buffer, content + offset, sizeof(buffer)));
+	}
+	fat_close_file(fd);
+	return fat_image_stats.fat_reads - start;
+}
+
+static uint32_t scan_reads(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name)	//FAT reads of a scan
+{
+	struct fat_file_struct* fd = fat_image_open(fs, dd, name, 0);
+	uint8_t buffer[64];
+	uint32_t start = fat_image_stats.fat_reads;
+
+	CHECK(fd != 0);
+	if(!fd) return 0;
+	for(uint32_t offset=0;offset<sizeof(content);offset+=sizeof(buffer)){
+		CHECK(fat_read_file(fd, buffer, sizeof(buffer)) == sizeof(buffer));
+		CHECK(!memcmp(buffer, content + offset, sizeof(buffer)));
+	}
+	fat_close_file(fd);
+	return fat_image_stats.fat_reads - start;
+}
+
+int main(void)
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+
+	for(uint32_t i=0;i<sizeof(content);i++) content[i] = i % 512 < 4 ? (uint32_t)(i / 512) >> ((i % 4) * 8) : (uint32_t)rand();
+	fat_image_format(&image, 6000, 0);
+	fat_image_add_file(&image, "flat.bin", content, sizeof(content), 0, 0);
+	fat_image_add_file(&image, "frag.bin", content, sizeof(content), 7, 3);	//runs of 7 clusters, 9 runs
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) TEST_END();
+
+	srand(10);
+	uint32_t flat_first = seek_reads(fs, dd, "flat.bin");
+	uint32_t flat_again = seek_reads(fs, dd, "flat.bin");
+	uint32_t frag_first = seek_reads(fs, dd, "frag.bin");
+	uint32_t frag_again = seek_reads(fs, dd, "frag.bin");
+	uint32_t flat_scan = scan_reads(fs, dd, "flat.bin");
+	uint32_t frag_scan = scan_reads(fs, dd, "frag.bin");
+	printf("FAT_EXTENT_COUNT %u, FAT reads for %u seeks: contiguous %u then %u, fragmented %u then %u\n",
+		   FAT_EXTENT_COUNT, SEEKS, flat_first, flat_again, frag_first, frag_again);
+	printf("FAT reads for a scan: contiguous %u, fragmented %u\n", flat_scan, frag_scan);
+	CHECK(flat_scan <= FILE_CLUSTERS);					//one FAT entry per cluster at most
+	CHECK(frag_scan <= FILE_CLUSTERS);
+#if FAT_EXTENT_COUNT
+	CHECK(flat_again == 0);								//a contiguous chain is one run
+#endif
+#if FAT_EXTENT_COUNT >= 9
+	CHECK(frag_again == 0);
+#endif
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+	TEST_END();
+}
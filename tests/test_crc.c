@@ -0,0 +1,115 @@
+/*
+ * test_crc.c
+ *
+ * Created: 18.10.2026 16:42:09
+ */
+//CRC variants of dallas.c and kt-01.c. The test is built once per
+//DS_CRC_TABLE/KT_CRC_TABLE value and checks that build against the
+//original bitwise loops, then times it. The time is host time, only the
+//ratio between the variants means anything.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "dallas.h"
+#include "kt-01.h"
+#include "test.h"
+
+#define BENCH_BYTES 4000000UL
+
+static const char* const variant_name[3] = {"bitwise", "nibble table", "full table"};
+
+static uint8_t ref_ds_crc(uint8_t crc, uint8_t data)		//ds_crc() before the tables
+{
+	crc ^= data;
+	for (uint8_t i=0; i<8; i++){
+		if (crc & 0x01)
+		crc = (crc >> 1) ^ 0x8C;
+		else
+		crc >>= 1;
+	}
+	return crc;
+}
+
+static uint8_t ref_kt_crc(uint8_t* data, uint8_t len)		//kt_crc() before the tables
+{
+	uint8_t crc = 0;
+	while (len--){
+		crc ^= *data++;
+		for (uint8_t i=0; i<8; i++){
+			if (crc & 0x01)
+			crc = (crc >> 1) ^ 0x0B;
+			else
+			crc >>= 1;
+		}
+	}
+	return crc;
+}
+
+static void test_ds(void)
+{
+	uint8_t rom[8] = {0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2};	//example ROM of Maxim AN27
+	uint8_t buffer[32];
+
+	for(uint16_t crc=0;crc<256;crc++)
+		for(uint16_t data=0;data<256;data++) CHECK(ds_crc(crc, data) == ref_ds_crc(crc, data));
+	CHECK(ds_crc_block(rom, 7) == 0xA2);
+	CHECK(ds_crc_block(rom, 8) == 0);
+	CHECK(ds_crc_check(rom) == 0);
+	rom[3] ^= 0x10;
+	CHECK(ds_crc_check(rom) != 0);
+	for(uint8_t len=0;len<=sizeof(buffer);len++){
+		uint8_t crc = 0;
+		for(uint8_t i=0;i<len;i++) buffer[i] = rand();
+		for(uint8_t i=0;i<len;i++) crc = ref_ds_crc(crc, buffer[i]);
+		CHECK(ds_crc_block(buffer, len) == crc);
+	}
+}
+
+static void test_kt(void)
+{
+	uint8_t buffer[32];
+
+	for(uint16_t data=0;data<256;data++){
+		buffer[0] = data;
+		CHECK(kt_crc(buffer, 1) == ref_kt_crc(buffer, 1));
+	}
+	for(uint16_t n=0;n<1000;n++){
+		uint8_t len = n % (sizeof(buffer) + 1);
+		for(uint8_t i=0;i<len;i++) buffer[i] = rand();
+		CHECK(kt_crc(buffer, len) == ref_kt_crc(buffer, len));
+	}
+}
+
+static double now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void bench(void)
+{
+	static uint8_t buffer[250];
+	volatile uint8_t sink = 0;
+	double start;
+
+	for(uint8_t i=0;i<sizeof(buffer);i++) buffer[i] = rand();
+	start = now_ns();
+	for(uint32_t n=0;n<BENCH_BYTES/sizeof(buffer);n++) sink ^= ds_crc_block(buffer, sizeof(buffer));
+	printf("ds_crc %-13s %6.2f ns/byte\n", variant_name[DS_CRC_TABLE], (now_ns() - start) / BENCH_BYTES);
+	start = now_ns();
+	for(uint32_t n=0;n<BENCH_BYTES/sizeof(buffer);n++) sink ^= kt_crc(buffer, sizeof(buffer));
+	printf("kt_crc %-13s %6.2f ns/byte\n", variant_name[KT_CRC_TABLE], (now_ns() - start) / BENCH_BYTES);
+	(void)sink;
+}
+
+int main(void)
+{
+	srand(6);
+	test_ds();
+	test_kt();
+	bench();
+	TEST_END();
+}
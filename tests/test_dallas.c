@@ -0,0 +1,251 @@
+/*
+ * test_dallas.c
+ *
+ * Created: 18.10.2026 0:12:36
+ */
+//1-Wire engine of dallas.c against the iButton model: slot timing as seen
+//on the line, presence timestamp, ROM reads at standard and overdrive
+//speed, the read back of a programmed blank and Search ROM over several
+//keys.
+
+#include <string.h>
+#include "sim.h"
+#include "ow_device.h"
+#include "dallas.h"
+#include "test.h"
+
+static uint8_t rom[8] = {0x01, 0x5A, 0x3C, 0x11, 0x22, 0x33, 0x00, 0x00};
+
+static double pulse_us(uint16_t i)
+{
+	return SIM_TIME_US(ow_log[i].low);
+}
+
+static double period_us(uint16_t i)						//fall to fall
+{
+	return SIM_TIME_US(ow_log[i + 1].fall - ow_log[i].fall);
+}
+
+static void setup(uint8_t overdrive)
+{
+	sim_reset();
+	ow_bus_attach();
+	ow_device_add(rom, 30, overdrive);
+	ds_init();
+	sei();
+}
+
+static void test_slots(void)
+{
+	uint8_t data = 0xA5, read = 0;
+
+	setup(0);
+	CHECK(ds_reset() == 0);
+	CHECK(ow_log_count == 1);
+	CHECK_RANGE(pulse_us(0), 899.5, 900.5);
+
+	ow_log_count = 0;
+	ds_write_byte(data);
+	CHECK(ow_log_count == 8);
+	for(uint8_t i=0;i<8;i++){
+		if((data >> i) & 0x01) CHECK_RANGE(pulse_us(i), 4.5, 5.5);
+		else CHECK_RANGE(pulse_us(i), 59.5, 60.5);
+		if(i < 7) CHECK_RANGE(period_us(i), 99.5, 100.5);
+	}
+
+	CHECK(ds_reset() == 0);
+	ds_write_byte(0x33);
+	ow_log_count = 0;
+	for(uint8_t i=0;i<8;i++){
+		read = ds_read_byte();
+		CHECK(read == rom[i]);							//device holds 0 for 15 us, sampled at 10 us
+	}
+	for(uint16_t i=0;i<ow_log_count;i++) CHECK_RANGE(pulse_us(i), 4.5, 5.5);
+}
+
+static void test_presence(void)
+{
+	setup(0);
+	CHECK(ds_timeslot() == 30);
+	ow_device_remove(0);
+	CHECK(ds_reset() == 2);
+	CHECK(ds_timeslot() == 0);
+}
+
+static void test_read_rom(void)
+{
+	uint8_t data[8];
+
+	setup(0);
+	CHECK(ds_read_rom(data) == DS_READ_ROM_OK);
+	for(uint8_t i=0;i<8;i++) CHECK(data[i] == rom[i]);
+	CHECK(ds_time == 30);
+}
+
+static double read_us(uint8_t* data)					//Read ROM after a reset, at the current speed
+{
+	uint64_t start = hal_cycles;
+	ds_write_byte(0x33);
+	for(uint8_t i=0;i<8;i++) data[i] = ds_read_byte();
+	return SIM_TIME_US(hal_cycles - start);
+}
+
+static void test_overdrive(void)
+{
+	uint8_t data[8];
+	uint64_t start;
+	double standard, overdrive, negotiate;
+
+	setup(1);
+	start = hal_cycles;
+	CHECK(ds_reset() == 0);
+	standard = SIM_TIME_US(hal_cycles - start) + read_us(data);
+	CHECK(!memcmp(data, rom, 8));
+	start = hal_cycles;
+	CHECK(ds_overdrive() == 0);
+	negotiate = SIM_TIME_US(hal_cycles - start);
+	CHECK(ds_speed() == 1);
+	overdrive = read_us(data);
+	CHECK(!memcmp(data, rom, 8));
+	ds_standard();
+	printf("ROM read: standard %.0f us, overdrive %.0f us after %.0f us of reset and 0x3C\n", standard, overdrive, negotiate);
+	CHECK_RANGE(standard, 8000, 10000);
+	CHECK(overdrive < 1000);
+	CHECK(negotiate + overdrive < standard / 2);
+
+	setup(0);											//no overdrive: stays at standard speed, still readable
+	CHECK(ds_overdrive() == 0);
+	CHECK(ds_speed() == 0);
+	read_us(data);
+	CHECK(!memcmp(data, rom, 8));
+}
+
+static double rom_job_us(uint8_t overdrive, uint8_t* result)	//ds_read_rom() of a key without a valid CRC
+{
+	uint8_t data[8];
+	uint64_t start;
+
+	setup(overdrive);
+	start = hal_cycles;
+	*result = ds_read_rom(data);
+	return SIM_TIME_US(hal_cycles - start);
+}
+
+static void test_overdrive_verify(void)					//a bad CRC is searched, then read 8 times more at overdrive
+{
+	uint8_t standard_result, overdrive_result, crc = rom[7];
+	double standard, overdrive;
+
+	rom[7] ^= 0xFF;
+	standard = rom_job_us(0, &standard_result);
+	overdrive = rom_job_us(1, &overdrive_result);
+	rom[7] = crc;
+	printf("ROM without CRC, read, search, 8 reads: standard %.2f ms, overdrive %.2f ms\n", standard / 1000, overdrive / 1000);
+	CHECK(standard_result == DS_READ_ROM_CRC_ERR);			//stable code, reported as such
+	CHECK(overdrive_result == standard_result);
+	CHECK(overdrive < standard / 2);
+}
+
+static void test_verify_stop(void)						//read back after programming ends at the first wrong bit
+{
+	uint8_t data[8];
+	uint16_t last = 0, before = 0;
+
+	memcpy(data, rom, sizeof(data));
+	data[2] ^= 0x10;									//bit 20 did not burn
+	setup(1);
+	ow_log_count = 0;
+	CHECK(ds_program_tm08v2(data) == DS_READ_ROM_CRC_ERR);
+	CHECK(ds_verify_bit == 20);
+	for(uint16_t i=0;i<ow_log_count;i++) if(pulse_us(i) > 400){before = last; last = i;}	//standard resets
+	CHECK(last == ow_log_count - 1);					//nothing after the closing reset
+	CHECK(last - before - 1 == 8 + 21);					//Read ROM, then the bits up to the wrong one
+	CHECK(ds_speed() == 0);
+}
+
+static void add_keys(const uint8_t keys[][8], uint8_t count)	//same family, serials from bit 8 on
+{
+	sim_reset();
+	ow_bus_attach();
+	for(uint8_t k=0;k<count;k++) ow_device_add(keys[k], 30, 1);
+	ds_init();
+	sei();
+}
+
+static void test_search(void)
+{
+	static uint8_t keys[3][8] = {{0x01, 0x5A, 0x3C, 0x11, 0x22, 0x33, 0x00, 0x00},
+								 {0x01, 0x5A, 0x3D, 0x11, 0x22, 0x33, 0x00, 0x00},
+								 {0x01, 0x9A, 0x3C, 0x11, 0x22, 0x30, 0x00, 0x00}};
+	uint8_t data[8], found = 0, passes = 0, result;
+	uint64_t start;
+	double us;
+
+	for(uint8_t k=0;k<3;k++) for(uint8_t i=0;i<7;i++) keys[k][7] = ds_crc(i ? keys[k][7] : 0, keys[k][i]);
+	add_keys(keys, 3);
+	CHECK(ds_overdrive() == 0);
+	CHECK(ds_speed() == 1);
+	start = hal_cycles;
+	for(result = ds_search(data, 1); result == DS_READ_ROM_OK; result = ds_search(data, 0)){
+		for(uint8_t k=0;k<3;k++) if(!memcmp(data, keys[k], 8)) found |= 1 << k;
+		if(++passes > 3) break;
+	}
+	us = SIM_TIME_US(hal_cycles - start);
+	ds_standard();
+	printf("Search ROM at overdrive: %u keys in %.0f us\n", passes, us);
+	CHECK(result == DS_READ_ROM_NO_PRES);
+	CHECK(found == 0x07);
+	CHECK(passes == 3);									//every key once
+	CHECK(us < 10000);
+
+	add_keys(keys, 3);
+	start = hal_cycles;
+	CHECK(ds_read_rom(data) == DS_READ_ROM_MULTI);
+	us = SIM_TIME_US(hal_cycles - start);
+	printf("collision of 3 keys reported in %.2f ms\n", us / 1000);
+	CHECK(us < 35000);									//Read ROM and one search pass at standard speed
+
+	add_keys(keys, 1);									//one key searches to itself
+	CHECK(ds_search(data, 1) == DS_READ_ROM_OK);
+	CHECK(!memcmp(data, keys[0], 8));
+	CHECK(ds_search(data, 0) == DS_READ_ROM_NO_PRES);
+
+	add_keys(keys, 0);
+	CHECK(ds_search(data, 1) == DS_READ_ROM_NO_PRES);
+}
+
+static void test_program_standard(void)					//program slots never run at overdrive
+{
+	uint8_t data = 0x00;
+
+	setup(1);
+	CHECK(ds_overdrive() == 0);
+	CHECK(ds_speed() == 1);
+	ow_log_count = 0;
+	ds_start_program(&data, 8);
+	CHECK(ds_wait() == DS_READ_ROM_CRC_ERR);			//refused, nothing on the line
+	CHECK(ow_log_count == 0);
+	CHECK(ds_speed() == 1);
+	ds_standard();
+	CHECK(ds_reset() == 0);								//the device leaves overdrive
+	ow_log_count = 0;
+	ds_program_byte(0x00);
+	CHECK(ds_speed() == 0);
+	CHECK(ow_log_count == 8);
+	for(uint16_t i=0;i<ow_log_count;i++) CHECK_RANGE(pulse_us(i), 4.5, 90.5);
+	for(uint16_t i=0;i + 1<ow_log_count;i++) CHECK(period_us(i) >= 100);
+}
+
+int main(void)
+{
+	for(uint8_t i=0;i<7;i++) rom[7] = ds_crc(i ? rom[7] : 0, rom[i]);
+	test_slots();
+	test_presence();
+	test_read_rom();
+	test_overdrive();
+	test_overdrive_verify();
+	test_verify_stop();
+	test_search();
+	test_program_standard();
+	TEST_END();
+}
@@ -0,0 +1,116 @@
+/*
+ * test_dir.c
+ *
+ * Created: 19.10.2026 12:05:40
+ */
+//Name lookups of fat_find_dir_entry(), built once per FAT_DIR_CACHE_COUNT,
+//in a FAT16 root directory of FILES files and in a subdirectory. Counts the device reads and
+//card blocks of a first and a repeated lookup, and checks that lookups
+//stay right after files are deleted and created.
+
+#include <stdio.h>
+#include <string.h>
+#include "sd_card.h"
+#include "fat_image.h"
+#include "test.h"
+
+#define FILES 15										//fat_read_dir() stops the FAT16 root at the cluster size
+#define NAMES 4
+#define SUB_FILES 40
+
+static uint32_t reads, blocks;
+
+static uint8_t find(struct fat_dir_struct* dd, const char* name, struct fat_dir_entry_struct* entry)
+{
+	uint32_t start = fat_image_stats.reads, start_blocks = sd_card_stats.blocks_read;
+	uint8_t found = fat_find_dir_entry(dd, name, entry);
+	reads = fat_image_stats.reads - start;
+	blocks = sd_card_stats.blocks_read - start_blocks;
+	return found;
+}
+
+static uint32_t first_cluster(struct fat_dir_struct* dd, const char* name)
+{
+	struct fat_dir_entry_struct entry;
+	return find(dd, name, &entry) ? entry.cluster : 0;
+}
+
+int main(void)
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+	struct fat_dir_entry_struct entry;
+	uint32_t cluster[FILES];
+	uint8_t data[512];
+	char name[16];
+
+	memset(data, 0x5A, sizeof(data));
+	fat_image_format(&image, 6000, 0);
+	for(uint8_t i=0;i<FILES;i++){
+		sprintf(name, "file%02u.bin", i);
+		cluster[i] = fat_image_add_file(&image, name, data, sizeof(data), 0, 0);
+	}
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) TEST_END();
+
+	CHECK(first_cluster(dd, "file14.bin") == cluster[14]);
+	uint32_t first_reads = reads, first_blocks = blocks;
+	CHECK(first_cluster(dd, "file14.bin") == cluster[14]);
+	printf("FAT_DIR_CACHE_COUNT %u, last of %u files: first lookup %u reads %u blocks, again %u reads %u blocks\n",
+		   FAT_DIR_CACHE_COUNT, FILES, first_reads, first_blocks, reads, blocks);
+#if FAT_DIR_CACHE_COUNT
+	CHECK(reads == 1);
+	CHECK(blocks <= 1);
+#else
+	CHECK(reads == first_reads);
+#endif
+	CHECK(!find(dd, "none.bin", &entry));
+
+	//the names looked up last survive a delete before it and a create after it
+	for(uint8_t i=0;i<NAMES;i++){
+		sprintf(name, "file%02u.bin", 5 + i);
+		CHECK(first_cluster(dd, name) == cluster[5 + i]);
+	}
+	CHECK(find(dd, "file02.bin", &entry));
+	CHECK(fat_delete_file(fs, &entry));
+	CHECK(!find(dd, "file02.bin", &entry));
+	CHECK(fat_create_file(dd, "new.bin", &entry));		//takes the free entry of file02.bin
+	CHECK(find(dd, "new.bin", &entry));
+	CHECK(first_cluster(dd, "file14.bin") == cluster[14]);
+	for(uint8_t i=0;i<NAMES;i++){
+		sprintf(name, "file%02u.bin", 5 + i);
+		CHECK(first_cluster(dd, name) == cluster[5 + i]);
+	}
+
+	//a subdirectory spans several clusters, so only a cache hit saves card blocks
+	struct fat_dir_struct* sub;
+	CHECK(fat_create_dir(dd, "sub", &entry));
+	sub = fat_open_dir(fs, &entry);
+	CHECK(sub != 0);
+	if(!sub) TEST_END();
+	for(uint8_t i=0;i<SUB_FILES;i++){
+		sprintf(name, "key%02u.bin", i);
+		CHECK(fat_create_file(sub, name, &entry));
+	}
+	sd_raw_sync();
+	CHECK(find(sub, "key39.bin", &entry));
+	first_reads = reads;
+	first_blocks = blocks;
+	CHECK(find(sub, "key39.bin", &entry));
+	printf("last of %u files in a subdirectory: first lookup %u reads %u blocks, again %u reads %u blocks\n",
+		   SUB_FILES, first_reads, first_blocks, reads, blocks);
+	CHECK(first_blocks > 1);
+#if FAT_DIR_CACHE_COUNT
+	CHECK(reads == 1);
+	CHECK(blocks <= 1);
+#endif
+	CHECK(find(sub, "key00.bin", &entry));
+	CHECK(!find(sub, "key40.bin", &entry));
+	fat_close_dir(sub);
+
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+	TEST_END();
+}
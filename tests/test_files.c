@@ -0,0 +1,112 @@
+/*
+ * test_files.c
+ *
+ * Created: 19.10.2026 18:20:36
+ */
+//Files through the streaming card paths on FAT16 and FAT32 volumes: a
+//directory listing matches the files created in it, APPENDS appends in
+//sessions read back intact after a remount, and the free count matches a
+//scan of the image FAT.
+
+#include <stdio.h>
+#include <string.h>
+#include "fat_image.h"
+#include "test.h"
+
+#define FILES 30
+#define APPENDS 2000
+#define RECORD 16
+#define SESSION 50										//appends per open of the file
+
+static void record(uint8_t* buf, uint16_t n)
+{
+	for(uint8_t i=0;i<RECORD;i++) buf[i] = n * 31 + i + (n >> 8);
+}
+
+static uint16_t test_listing(struct fat_fs_struct* fs, struct fat_dir_struct* dd)
+{
+	struct fat_dir_entry_struct entry;
+	struct fat_dir_struct* sub;
+	uint8_t seen[FILES] = {0};
+	uint16_t listed = 0;
+	char name[16];
+
+	CHECK(fat_create_dir(dd, "keys", &entry));
+	sub = fat_open_dir(fs, &entry);
+	CHECK(sub != 0);
+	if(!sub) return 0;
+	for(uint8_t i=0;i<FILES;i++){
+		sprintf(name, "key%02u.csv", i);
+		CHECK(fat_create_file(sub, name, &entry));
+	}
+	while(fat_read_dir(sub, &entry)){
+		unsigned n;
+		listed++;
+		if(!strcmp(entry.long_name, ".") || !strcmp(entry.long_name, "..")) continue;
+		CHECK(sscanf(entry.long_name, "key%02u.csv", &n) == 1 && n < FILES);
+		if(n < FILES) seen[n]++;
+	}
+	CHECK(listed == FILES + 2);
+	uint16_t found = 0;
+	for(uint8_t i=0;i<FILES;i++) found += seen[i] == 1;
+	CHECK(found == FILES);
+	fat_close_dir(sub);
+	return found;
+}
+
+static void test_volume(uint8_t fat32)
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+	struct fat_file_struct* fd;
+	uint8_t buf[RECORD], back[RECORD];
+
+	fat_image_format(&image, fat32 ? 72000 : 6000, fat32);
+	fat_image_add_file(&image, "log.bin", 0, 0, 0, 0);
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) return;
+	uint16_t listed = test_listing(fs, dd);
+	for(uint16_t n=0;n<APPENDS;n+=SESSION){
+		int32_t end = 0;
+		fd = fat_image_open(fs, dd, "log.bin", 0);
+		CHECK(fd != 0);
+		if(!fd) return;
+		CHECK(fat_seek_file(fd, &end, FAT_SEEK_END));
+		for(uint16_t i=n;i<n + SESSION;i++){
+			record(buf, i);
+			CHECK(fat_write_file(fd, buf, RECORD) == RECORD);
+		}
+		fat_close_file(fd);
+		CHECK(sd_raw_sync());
+	}
+	fat_image_unmount(fs, dd);
+
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) return;
+	fd = fat_image_open(fs, dd, "log.bin", 0);
+	CHECK(fd != 0);
+	if(!fd) return;
+	uint16_t intact = 0;
+	for(uint16_t i=0;i<APPENDS;i++){
+		record(buf, i);
+		if(fat_read_file(fd, back, RECORD) == RECORD && !memcmp(buf, back, RECORD)) intact++;
+	}
+	CHECK(fat_read_file(fd, back, RECORD) == 0);
+	fat_close_file(fd);
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	printf("FAT%u: %u of %u files listed, %u of %u appends intact, free count %s\n", fat32 ? 32 : 16, listed, FILES, intact, APPENDS,
+		   fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL ? "matches" : "differs");
+	CHECK(intact == APPENDS);
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+}
+
+int main(void)
+{
+	test_volume(0);
+	test_volume(1);
+	TEST_END();
+}
@@ -0,0 +1,124 @@
+/*
+ * test_free.c
+ *
+ * Created: 19.10.2026 14:31:07
+ */
+//Free cluster accounting of fat.c on FAT16 and FAT32 volumes with USED
+//clusters taken in front of the free space. The free count is compared to
+//a scan of the image FAT after appends and a truncation, and the FAT reads
+//of the free count and of the first allocation are counted. On FAT32 the
+//count and the next free hint come from FSInfo and are written back, FAT16
+//has no hint and the first allocation loads the windows from cluster 2.
+//With the FSInfo count unknown the free count is read from the FAT, built
+//once more with FAT_FREE_CHUNK not a multiple of the read buffer.
+
+#include <stdlib.h>
+#include <string.h>
+#include "sd_card.h"
+#include "fat_image.h"
+#include "test.h"
+
+#define USED 20000
+#define APPEND 40										//clusters
+
+static uint8_t data[512];
+
+static uint32_t get32(const uint8_t* p)
+{
+	return p[0] | p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void test_volume(uint8_t fat32)
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+	struct fat_file_struct* fd;
+	uint32_t start;
+
+	fat_image_format(&image, fat32 ? 72000 : 30000, fat32);
+	fat_image_add_file(&image, "used.bin", 0, USED * 512UL, 0, 0);
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) return;
+
+	start = fat_image_stats.fat_reads;
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	uint32_t count_reads = fat_image_stats.fat_reads - start;
+	start = fat_image_stats.fat_reads;
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	CHECK(fat_image_stats.fat_reads == start);			//kept in RAM
+
+	fd = fat_image_open(fs, dd, "new.bin", 1);
+	CHECK(fd != 0);
+	if(!fd) return;
+	uint32_t free_before = fat_image_free_count(&image);
+	start = fat_image_stats.fat_reads;
+	uint32_t start_bytes = sd_card_stats.bytes;
+	CHECK(fat_write_file(fd, data, sizeof(data)) == sizeof(data));
+	uint32_t alloc_reads = fat_image_stats.fat_reads - start;
+	uint32_t alloc_bytes = sd_card_stats.bytes - start_bytes;
+	for(uint8_t i=1;i<APPEND;i++) CHECK(fat_write_file(fd, data, sizeof(data)) == sizeof(data));
+	sd_raw_sync();
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	CHECK(fat_image_free_count(&image) == free_before - APPEND);
+	CHECK(fat_resize_file(fd, 512));
+	sd_raw_sync();
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	printf("FAT%u, %u clusters used: free count %u FAT reads, first allocation %u FAT reads %u SPI bytes\n",
+		   fat32 ? 32 : 16, USED, count_reads, alloc_reads, alloc_bytes);
+	if(fat32){
+		CHECK(count_reads == 0);						//from FSInfo
+		CHECK(get32(image.data + 512 + 488) == fat_image_free_count(&image));
+		CHECK(alloc_reads < 4);							//starts at the FSInfo hint
+	}else CHECK(alloc_reads <= USED / FAT_FREE_WINDOW + 2);	//one streamed window per FAT_FREE_WINDOW used clusters
+	fat_close_file(fd);
+	fat_image_unmount(fs, dd);
+
+	if(fat32){											//the hint written back is used after a remount
+		fs = fat_image_mount(&image, &dd);
+		CHECK(fs != 0);
+		if(!fs) return;
+		fd = fat_image_open(fs, dd, "more.bin", 1);
+		CHECK(fd != 0);
+		start = fat_image_stats.fat_reads;
+		CHECK(fd && fat_write_file(fd, data, sizeof(data)) == sizeof(data));
+		printf("FAT32 after a remount: first allocation %u FAT reads\n", fat_image_stats.fat_reads - start);
+		CHECK(fat_image_stats.fat_reads - start < 4);
+		sd_raw_sync();
+		CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+		if(fd) fat_close_file(fd);
+		fat_image_unmount(fs, dd);
+	}
+	fat_image_release(&image);
+}
+
+static void test_scan(uint8_t fat32)					//free count read from the FAT
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+	uint32_t start;
+
+	fat_image_format(&image, fat32 ? 72000 : 30000, fat32);
+	fat_image_add_file(&image, "used.bin", 0, USED * 512UL, 0, 0);
+	if(fat32) memset(image.data + 512 + 488, 0xFF, 4);	//FSInfo count unknown
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) return;
+	start = fat_image_stats.fat_reads;
+	CHECK(fat_get_fs_free(fs) == fat_image_free_count(&image) * 512ULL);
+	CHECK(fat_image_stats.fat_reads > start);
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+}
+
+int main(void)
+{
+	memset(data, 0xA5, sizeof(data));
+	test_volume(0);
+	test_volume(1);
+	test_scan(0);
+	test_scan(1);
+	TEST_END();
+}
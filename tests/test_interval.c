@@ -0,0 +1,110 @@
+/*
+ * test_interval.c
+ *
+ * Created: 19.10.2026 19:40:12
+ */
+//fat_read_file_interval() against fat_read_file() on a contiguous and on a
+//fragmented file: units and their file positions, the return value, a
+//callback stopping early and a fat_read_file() continuing where the scan
+//stopped. Counts the SPI bytes and card blocks of a record scan.
+
+#include <stdlib.h>
+#include <string.h>
+#include "sd_card.h"
+#include "fat_image.h"
+#include "test.h"
+
+#define FILE_SIZE 30000
+#define SCAN 20000
+#define START 16										//keys.kdb header
+#define RECORD 12
+
+static uint8_t content[FILE_SIZE];
+static uint32_t next_pos, units, bad, stop_at;
+
+static uint8_t unit(uint8_t* buffer, offset_t pos, void* p)
+{
+	uintptr_t interval = (uintptr_t)p;
+	units++;
+	if(pos != next_pos || memcmp(buffer, content + pos, interval)) bad++;
+	next_pos += interval;
+	return units != stop_at;
+}
+
+static void scan(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name, uintptr_t interval, uint32_t stop)
+{
+	static uint8_t buffer[1000], after[16];
+	struct fat_file_struct* fd = fat_image_open(fs, dd, name, 0);
+	int32_t pos = START;
+	CHECK(fd && fat_seek_file(fd, &pos, FAT_SEEK_SET));
+	if(!fd) return;
+	next_pos = START;
+	units = bad = 0;
+	stop_at = stop;
+	intptr_t result = fat_read_file_interval(fd, buffer, interval, SCAN, unit, (void*)interval);
+	CHECK(bad == 0);
+	CHECK(result == (intptr_t)(units * interval));
+	if(stop) CHECK(units == stop);
+	else CHECK(units == SCAN / interval);
+	CHECK(fat_read_file(fd, after, sizeof(after)) == sizeof(after));	//continues after the last unit
+	CHECK(!memcmp(after, content + next_pos, sizeof(after)));
+	fat_close_file(fd);
+}
+
+static void cost(struct fat_fs_struct* fs, struct fat_dir_struct* dd, const char* name, uint8_t gaps)
+{
+	static uint8_t record[RECORD];
+	struct fat_file_struct* fd = fat_image_open(fs, dd, name, 0);
+	int32_t pos = START;
+	CHECK(fd && fat_seek_file(fd, &pos, FAT_SEEK_SET));
+	if(!fd) return;
+	units = bad = 0;
+	next_pos = START;
+	stop_at = 0;
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	fat_read_file_interval(fd, record, RECORD, SCAN, unit, (void*)RECORD);
+	uint32_t bytes = sd_card_stats.bytes, blocks = sd_card_stats.blocks_read;
+	fat_close_file(fd);
+
+	fd = fat_image_open(fs, dd, name, 0);
+	pos = START;
+	CHECK(fd && fat_seek_file(fd, &pos, FAT_SEEK_SET));
+	if(!fd) return;
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	for(uint32_t i=0;i<SCAN / RECORD;i++) CHECK(fat_read_file(fd, record, RECORD) == RECORD);
+	printf("%s, %u records: interval reader %u SPI bytes %u blocks, fat_read_file %u SPI bytes %u blocks\n",
+		   name, SCAN / RECORD, bytes, blocks, sd_card_stats.bytes, sd_card_stats.blocks_read);
+	if(gaps) CHECK(bytes < sd_card_stats.bytes);
+	else CHECK(blocks <= sd_card_stats.blocks_read + 1);		//both stream the whole run
+	fat_close_file(fd);
+}
+
+int main(void)
+{
+	const uintptr_t intervals[] = {RECORD, 7, 32, 512, 1000};
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+
+	srand(20);
+	for(uint32_t i=0;i<FILE_SIZE;i++) content[i] = rand();
+	fat_image_format(&image, 6000, 0);
+	fat_image_add_file(&image, "flat.kdb", content, FILE_SIZE, 0, 0);
+	fat_image_add_file(&image, "frag.kdb", content, FILE_SIZE, 3, 1);	//runs of 3 clusters
+	fs = fat_image_mount(&image, &dd);
+	CHECK(fs != 0);
+	if(!fs) TEST_END();
+
+	for(uint8_t i=0;i<sizeof(intervals)/sizeof(intervals[0]);i++){
+		scan(fs, dd, "flat.kdb", intervals[i], 0);
+		scan(fs, dd, "frag.kdb", intervals[i], 0);
+	}
+	scan(fs, dd, "flat.kdb", RECORD, 100);
+	scan(fs, dd, "frag.kdb", RECORD, 100);
+	scan(fs, dd, "frag.kdb", 1000, 3);					//stops on a unit assembled across a gap
+	cost(fs, dd, "flat.kdb", 0);
+	cost(fs, dd, "frag.kdb", 1);
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+	TEST_END();
+}
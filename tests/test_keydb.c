@@ -0,0 +1,85 @@
+/*
+ * test_keydb.c
+ *
+ * Created: 19.10.2026 10:42:18
+ */
+//Lookups in a keys.kdb on an in-memory FAT16 volume: every key of the
+//database is found at its record, random codes are not, and an unknown code
+//costs no more card reads than the binary search needs.
+
+#include <stdlib.h>
+#include <string.h>
+#include "fat_image.h"
+#include "keydb.h"
+#include "test.h"
+
+#define PROBES 2000
+
+static uint8_t kdb[KEYDB_HEADER_SIZE + 2000 * KEYDB_RECORD_SIZE];
+
+static int code_cmp(const void* a, const void* b)
+{
+	return memcmp(a, b, 8);
+}
+
+static uint32_t make_kdb(uint16_t records)			//random codes sorted, no index or addresses
+{
+	memset(kdb, 0, sizeof(kdb));
+	memcpy(kdb, "KDB1", 4);
+	kdb[4] = records;
+	kdb[5] = records >> 8;
+	for(uint16_t i=0;i<records;i++){
+		uint8_t* record = kdb + KEYDB_HEADER_SIZE + i * KEYDB_RECORD_SIZE;
+		for(uint8_t b=0;b<8;b++) record[b] = rand();
+	}
+	qsort(kdb + KEYDB_HEADER_SIZE, records, KEYDB_RECORD_SIZE, code_cmp);
+	return KEYDB_HEADER_SIZE + (uint32_t)records * KEYDB_RECORD_SIZE;
+}
+
+static void lookups(uint16_t records)
+{
+	struct fat_image image;
+	struct fat_fs_struct* fs;
+	struct fat_dir_struct* dd;
+	struct fat_file_struct* fd;
+	struct keydb_struct db;
+	struct keydb_record_struct record;
+	uint32_t reads;
+	uint8_t steps = 0;
+
+	while((1UL << steps) <= records) steps++;			//records read by a miss
+	fat_image_format(&image, 6000, 0);
+	fat_image_add_file(&image, "keys.kdb", kdb, make_kdb(records), 0, 0);
+	fs = fat_image_mount(&image, &dd);
+	fd = fs ? fat_image_open(fs, dd, "keys.kdb", 0) : 0;
+	CHECK(fd != 0);
+	if(!fd) return;
+	CHECK(keydb_open(fd, &db));
+	CHECK(db.records == records);
+	for(uint16_t i=0;i<records;i++){
+		const uint8_t* code = kdb + KEYDB_HEADER_SIZE + i * KEYDB_RECORD_SIZE;
+		CHECK(keydb_find(fd, &db, code, &record) == i);
+		CHECK(!memcmp(record.code, code, 8));
+	}
+	reads = fat_image_stats.reads;
+	for(uint16_t i=0;i<PROBES;i++){
+		uint8_t code[8];
+		for(uint8_t b=0;b<8;b++) code[b] = rand();
+		CHECK(keydb_find(fd, &db, code, &record) == KEYDB_NONE);
+	}
+	reads = fat_image_stats.reads - reads;
+	printf("%4u keys: %.2f card reads per unknown code, %u search steps\n", records, (double)reads / PROBES, steps);
+	CHECK_RANGE((double)reads / PROBES, 1, steps + 1);		//a record across two blocks reads both
+	fat_close_file(fd);
+	fat_image_unmount(fs, dd);
+	fat_image_release(&image);
+}
+
+int main(void)
+{
+	const uint16_t counts[] = {1, 50, 500, 2000};
+
+	srand(12);
+	for(uint8_t i=0;i<sizeof(counts)/sizeof(counts[0]);i++) lookups(counts[i]);
+	TEST_END();
+}
\ No newline at end of file
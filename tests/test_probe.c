@@ -0,0 +1,134 @@
+/*
+ * test_probe.c
+ *
+ * Created: 18.10.2026 14:05:12
+ */
+//Key probing of main.c: what one pass of probe_key() costs with nothing on
+//the contact and how long a presented key takes to be found from any point
+//of the probe round. Probes run to completion, one per call, so the
+//detection time is bounded by the round, not by a time slice.
+
+#include <string.h>
+#include "sim.h"
+#include "ow_device.h"
+#include "adc.h"
+#include "dallas.h"
+#include "rfid.h"
+#include "kt-01.h"
+#include "sound.h"
+#include "test.h"
+
+//main.c has no header, these mirror its definitions
+#define KEY_NO_KEY 0
+#define KEY_DALLAS 1
+#define KEY_RESIST 10
+#define PROBES 3
+void adc_init(void);
+uint8_t probe_key(void);
+extern uint8_t probe_order[PROBES];
+extern uint8_t probe_slot;
+extern uint8_t in_data[8];
+
+static const char* const probe_name[PROBES] = {"Dallas/RFID/KT-01", "Metakom/Cyfral", "resistor"};
+static uint8_t rom[8] = {0x01, 0x5A, 0x3C, 0x11, 0x22, 0x33, 0x00, 0x00};
+static uint16_t resistor_adc;
+
+static uint16_t resistor_input(uint8_t channel)			//divider of the pull-up and a resistor key on ADC0
+{
+	if(channel == 0) return resistor_adc;
+	return sim_pin(SIM_PORTC, channel) ? 0x3FF : 0;
+}
+
+static void setup(void)
+{
+	sim_reset();
+	ow_bus_attach();
+	adc_init();
+	sound_init();
+	ds_init();
+	rfid_init();
+	kt_init();
+	sei();
+	for(uint8_t i=0;i<PROBES;i++) probe_order[i] = i;
+	probe_slot = 0;
+}
+
+static double probe_ms(uint8_t* found)					//one probe_key() call
+{
+	uint64_t start = hal_cycles;
+	*found = probe_key();
+	return SIM_TIME_US(hal_cycles - start) / 1000;
+}
+
+static double detect_ms(uint8_t key, uint8_t* passes)		//until key is found, from the current slot
+{
+	uint64_t start = hal_cycles;
+	uint8_t found = KEY_NO_KEY;
+	for(*passes=0;*passes<12*PROBES && found == KEY_NO_KEY;(*passes)++) found = probe_key();
+	CHECK(found == key);
+	return SIM_TIME_US(hal_cycles - start) / 1000;
+}
+
+static void test_idle(void)
+{
+	double round = 0;
+	uint8_t found;
+
+	setup();
+	for(uint8_t i=0;i<PROBES;i++){
+		uint8_t probe = probe_order[probe_slot];
+		double ms = probe_ms(&found);
+		CHECK(found == KEY_NO_KEY);
+		printf("idle %-18s %7.2f ms\n", probe_name[probe], ms);
+		if(probe != 0) CHECK_RANGE(ms, 0, 2);	//skipped on the idle line after the baseline
+		round += ms;
+	}
+	CHECK(probe_slot == 0);
+	printf("idle round %21.2f ms\n", round);
+}
+
+static void test_dallas(void)
+{
+	for(uint8_t slot=0;slot<PROBES;slot++){
+		uint8_t passes;
+		double ms;
+
+		setup();
+		for(uint8_t i=0;i<slot;i++) probe_key();		//key arrives mid round
+		ow_device_add(rom, 30, 0);
+		ms = detect_ms(KEY_DALLAS, &passes);
+		printf("Dallas from slot %u %13.2f ms, %u passes\n", slot, ms, passes);
+		for(uint8_t i=0;i<8;i++) CHECK(in_data[i] == rom[i]);
+		CHECK(probe_order[0] == 0);
+		CHECK(probe_slot == 0);
+		CHECK_RANGE(passes, 1, PROBES - slot + 1);
+	}
+}
+
+static void test_resistor(void)
+{
+	uint8_t passes, found;
+	double ms;
+
+	setup();
+	probe_key();										//round starts past the resistor probe
+	resistor_adc = 512;									//1 kOhm against the 1 kOhm pull-up
+	sim_adc_input = resistor_input;
+	ms = detect_ms(KEY_RESIST, &passes);
+	printf("resistor %21.2f ms, %u passes\n", ms, passes);
+	CHECK_RANGE(passes, 9, 9 * PROBES);					//resist_read() wants 9 low readings in a row
+	CHECK(!strcmp((char*)in_data, " 1000"));
+	CHECK(probe_order[0] == 2);
+	ms = probe_ms(&found);								//promoted, read again first
+	CHECK(found == KEY_RESIST);
+	printf("resistor again %15.2f ms\n", ms);
+}
+
+int main(void)
+{
+	for(uint8_t i=0;i<7;i++) rom[7] = ds_crc(i ? rom[7] : 0, rom[i]);
+	test_idle();
+	test_dallas();
+	test_resistor();
+	TEST_END();
+}
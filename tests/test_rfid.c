@@ -0,0 +1,143 @@
+/*
+ * test_rfid.c
+ *
+ * Created: 18.10.2026 15:20:44
+ */
+//Streaming EM4100 decoder of rfid.c against the buffer decoder it
+//replaced: both get the same Manchester-decoded bitstreams (clean frames
+//after random lead-in, frames with flipped bits, plain noise) and must
+//agree on whether a frame is found and on the code.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "rfid.h"
+#include "test.h"
+
+#define STREAM_BITS (RFID_BUFFER_SIZE * 8)				//bit budget of rfid_read()
+#define STREAMS 50000
+
+//rfid.c has no declarations for these
+extern uint8_t rfid_buffer[RFID_BUFFER_SIZE];
+void rfid_encode(uint8_t* data);
+
+//the old loop reads one bit past the end for a header ending at bit 145, that
+//bit was whatever followed the buffer in RAM, here it is a 1 (no stop bit)
+static uint8_t old_buffer[RFID_BUFFER_SIZE + 1];
+
+//search loop of rfid_read() before the streaming decoder, code unchanged
+static uint8_t old_decode(uint8_t* data)
+{
+	uint8_t* rfid_buffer = old_buffer;
+	for (uint8_t s=0,ones=0,error=0;s<RFID_BUFFER_SIZE*8-54;s++){
+		if(rfid_buffer[s/8] & 1<<(s%8)) ones++;
+		else ones = 0;
+		if(ones == 9){
+			ones = 0;
+			s++;
+			for(uint8_t r=0;r<10;r++){
+				uint8_t p = 0;
+				for(uint8_t c=0;c<5;c++) if(rfid_buffer[(r*5+c+s)/8] & 1<<((r*5+c+s)%8)) p ^= 1;
+				if(p) error = 1;
+			}
+			for(uint8_t c=0;c<4;c++){
+				uint8_t pc = 0;
+				for(uint8_t r=0;r<11;r++) if(rfid_buffer[(r*5+c+s)/8] & 1<<((r*5+c+s)%8)) pc ^= 1;
+				if(pc) error = 1;
+			}
+			if(rfid_buffer[(54+s)/8] & 1<<((54+s)%8)) error = 1;
+
+			if(error){
+				error = 0;
+				continue;
+			}
+
+			for(uint8_t i=0;i<8;i++) data[i] = 0;
+
+			for(uint8_t byte=0;byte<5;byte++){
+				for(uint8_t nibble=0;nibble<2;nibble++){
+					for(uint8_t bit=0;bit<4;bit++)
+						if(rfid_buffer[(byte*10+nibble*5+bit+s)/8] & 1<<((byte*10+nibble*5+bit+s)%8))
+							data[5-byte] |= 0x80>>(nibble*4+bit);
+				}
+			}
+			return RFID_OK;
+		}
+	}
+	return RFID_PARITY_ERR;
+}
+
+static uint8_t new_decode(const uint8_t* stream, uint8_t* data)
+{
+	uint8_t code[8];
+	em4100_sync();
+	for(uint16_t i=0;i<STREAM_BITS;i++){
+		if(em4100_bit(stream[i], code) != RFID_OK) continue;
+		memcpy(data, code, 8);
+		return RFID_OK;
+	}
+	return RFID_PARITY_ERR;
+}
+
+static uint16_t put_frame(uint8_t* stream, uint16_t pos, const uint8_t* data)
+{
+	rfid_encode((uint8_t*)data);
+	for(uint8_t b=0;b<64 && pos<STREAM_BITS;b++) stream[pos++] = (rfid_buffer[b>>3] >> (7 - (b & 0x07))) & 0x01;
+	return pos;
+}
+
+static void make_stream(uint8_t* stream, uint8_t* key)
+{
+	uint16_t pos = 0, lead = rand() % 3 ? rand() % 80 : rand() % STREAM_BITS;
+	uint8_t flips = rand() % 4 ? 0 : rand() % 4;
+
+	memset(key, 0, 8);
+	for(uint8_t i=1;i<6;i++) key[i] = rand();
+	if(rand() % 8 == 0) key[1 + rand() % 5] = 0xFF;		//runs of ones inside the data
+	while(pos < lead) stream[pos++] = rand() & 0x01;
+	while(pos < STREAM_BITS) pos = put_frame(stream, pos, key);
+	while(flips--) stream[rand() % STREAM_BITS] ^= 1;
+}
+
+static void test_known(void)							//a clean frame decodes to its code
+{
+	uint8_t stream[STREAM_BITS], data[8] = {0};
+	const uint8_t key[8] = {0, 0x12, 0x34, 0x56, 0x78, 0x9A, 0, 0};
+
+	memset(stream, 0, sizeof(stream));
+	put_frame(stream, 10, key);
+	CHECK(new_decode(stream, data) == RFID_OK);
+	CHECK(!memcmp(data, key, 8));
+	stream[10 + 9 + 7] ^= 1;							//row parity error
+	CHECK(new_decode(stream, data) == RFID_PARITY_ERR);
+}
+
+static void test_against_old(void)
+{
+	uint8_t stream[STREAM_BITS], key[8], old_data[8], new_data[8];
+	unsigned found = 0, mismatch = 0;
+
+	srand(5);
+	for(unsigned n=0;n<STREAMS;n++){
+		make_stream(stream, key);
+		memset(old_buffer, 0, sizeof(old_buffer));
+		old_buffer[RFID_BUFFER_SIZE] = 0x01;
+		for(uint16_t i=0;i<STREAM_BITS;i++) if(stream[i]) old_buffer[i/8] |= 1<<(i%8);
+		memset(old_data, 0, 8);
+		memset(new_data, 0, 8);
+		uint8_t old_result = old_decode(old_data);
+		uint8_t new_result = new_decode(stream, new_data);
+		if(old_result != new_result || memcmp(old_data, new_data, 8)) mismatch++;
+		found += old_result == RFID_OK;
+	}
+	printf("%u streams, %u frames found by the old decoder, %u mismatches\n", STREAMS, found, mismatch);
+	CHECK(found > STREAMS / 2);
+	CHECK(mismatch == 0);
+}
+
+int main(void)
+{
+	test_known();
+	test_against_old();
+	TEST_END();
+}
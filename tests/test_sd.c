@@ -0,0 +1,115 @@
+/*
+ * test_sd.c
+ *
+ * Created: 18.10.2026 17:30:52
+ */
+//sd_raw.c against the SPI card model: streamed appends with CMD25, the
+//write-back block cache and its sync points.
+
+#include <string.h>
+#include "sim.h"
+#include "sd_card.h"
+#include "sd_raw.h"
+#include "test.h"
+
+#define CARD_BLOCKS 2048
+
+static uint8_t card[CARD_BLOCKS * 512];
+
+static void setup(void)
+{
+	sim_reset();
+	memset(card, 0, sizeof(card));
+	sd_card_attach(card, CARD_BLOCKS);
+	CHECK(sd_raw_init());
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+}
+
+static void test_write_stream(void)						//append starting inside a block
+{
+	uint8_t data[1500];
+
+	setup();
+	memset(card + 10 * 512, 0xAA, 512);
+	memset(card + 13 * 512, 0x55, 512);
+	for(uint16_t i=0;i<sizeof(data);i++) data[i] = i * 7;
+	CHECK(sd_raw_write_stream(10 * 512 + 100, data, 1000));
+	CHECK(sd_raw_write_stream(10 * 512 + 1100, data + 1000, 500));
+	CHECK(sd_raw_sync());
+	for(uint16_t i=0;i<100;i++) CHECK(card[10 * 512 + i] == 0xAA);	//kept in front of the write position
+	CHECK(!memcmp(card + 10 * 512 + 100, data, sizeof(data)));
+	for(uint16_t i=100 + sizeof(data);i<4 * 512;i++) CHECK(card[10 * 512 + i] == 0);	//block 13 entered at its start
+	CHECK(sd_card_stats.blocks_read == 1);				//only the partial first block
+	CHECK(sd_card_stats.blocks_written == 4);
+}
+
+static void test_read_stream(void)						//a clean cache does not stop the CMD18 transfer
+{
+	uint8_t data[64];
+
+	setup();
+	for(uint32_t i=0;i<64 * 512;i++) card[100 * 512 + i] = i * 13 + i / 512;
+	CHECK(sd_raw_write(5 * 512, data, sizeof(data)));	//dirty block elsewhere
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+	for(uint32_t offset=0;offset<64 * 512;offset+=sizeof(data)){
+		CHECK(sd_raw_read_stream(100 * 512 + offset, data, sizeof(data)));
+		CHECK(!memcmp(data, card + 100 * 512 + offset, sizeof(data)));
+	}
+	printf("64 blocks streamed after a write-back: %u commands, %u blocks written\n", sd_card_stats.commands, sd_card_stats.blocks_written);
+	CHECK(sd_card_stats.blocks_written == 1);
+	CHECK(sd_card_stats.commands <= 2);					//write-back and one CMD18
+	CHECK(sd_raw_sync());								//nothing to write
+	CHECK(sd_card_stats.blocks_written == 1);
+}
+
+static uint8_t scanned[10 * 512];
+static uint32_t scanned_length, scan_stop;
+
+static uint8_t scan_unit(uint8_t* buffer, offset_t offset, void* p)
+{
+	uintptr_t interval = *(uintptr_t*)p;
+	CHECK(offset == 200 * 512UL + 100 + scanned_length);
+	memcpy(scanned + scanned_length, buffer, interval);
+	scanned_length += interval;
+	return scanned_length < scan_stop;
+}
+
+static void test_interval_stream(void)					//units across block borders, the dirty cached block
+{
+	uint8_t unit[40], expected[10 * 512];
+	uintptr_t interval = 24;
+
+	setup();
+	for(uint32_t i=0;i<10 * 512;i++) card[200 * 512 + i] = i * 7 + i / 512;
+	memcpy(expected, card + 200 * 512, sizeof(expected));
+	memset(unit, 0xEE, sizeof(unit));
+	CHECK(sd_raw_write(203 * 512 + 500, unit, 20));		//the part in block 204 stays in the cache
+	memcpy(expected + 3 * 512 + 500, unit, 20);
+	memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+
+	scanned_length = 0;
+	scan_stop = 0xFFFFFFFF;
+	CHECK(sd_raw_read_interval_stream(200 * 512 + 100, unit, interval, 9 * 512, scan_unit, &interval));
+	CHECK(scanned_length == 9 * 512 / interval * interval);	//the partial last unit is left out
+	CHECK(!memcmp(scanned, expected + 100, scanned_length));
+	printf("interval scan of 9 blocks: %u commands, %u blocks read, %u written\n", sd_card_stats.commands, sd_card_stats.blocks_read, sd_card_stats.blocks_written);
+	CHECK(sd_card_stats.commands == 1);
+	CHECK(sd_card_stats.blocks_written == 0);			//the cache is not written back by the scan
+
+	scanned_length = 0;									//the callback stops the scan
+	interval = 40;
+	scan_stop = 5 * interval;
+	CHECK(sd_raw_read_interval_stream(200 * 512 + 100, unit, interval, 9 * 512, scan_unit, &interval));
+	CHECK(scanned_length == scan_stop);
+	CHECK(!memcmp(scanned, expected + 100, scanned_length));
+	CHECK(sd_raw_sync());
+	CHECK(!memcmp(card + 200 * 512, expected, sizeof(expected)));
+}
+
+int main(void)
+{
+	test_write_stream();
+	test_read_stream();
+	test_interval_stream();
+	TEST_END();
+}
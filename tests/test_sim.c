@@ -0,0 +1,59 @@
+/*
+ * test_sim.c
+ *
+ * Created: 17.10.2026 23:24:40
+ */
+//Timing of the simulated peripherals the firmware depends on.
+
+#include "sim.h"
+#include "test.h"
+
+static uint32_t t2_count, t1_count;
+static uint64_t t1_last;
+
+ISR(TIMER2_OVF_vect)
+{
+	t2_count++;
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	t1_last = hal_cycles;
+	t1_count++;
+	OCR1B += 200;										//100 us at clk/8
+}
+
+int main(void)
+{
+	sim_reset();
+	TCCR2B = (1<<CS22)|(1<<CS21)|(1<<CS20);				//clk/1024, as the button timer of main.c
+	TIMSK2 = 1<<TOIE2;
+	sei();
+	_delay_ms(1000);
+	CHECK(t2_count == 61);								//16.384 ms period
+
+	TCCR1B = 1<<CS11;
+	OCR1B = TCNT1 + 200;
+	TIFR1 = 1<<OCF1B;
+	TIMSK1 |= 1<<OCIE1B;
+	uint64_t start = hal_cycles;
+	_delay_us(1050);
+	CHECK(t1_count == 10);
+	CHECK(t1_last - start == SIM_US(1000));
+
+	cli();												//flags wait for the I bit
+	_delay_us(300);
+	CHECK(t1_count == 10);
+	sei();
+	hal_idle();
+	CHECK(t1_count == 11);
+
+	DDRC &= ~1;											//pin change on PC0
+	PCMSK1 = 1<<PCINT8;
+	sim_pin_low[SIM_PORTC] = 1;
+	_delay_us(1);
+	CHECK(sim_pin(SIM_PORTC, 0) == 0);
+	CHECK((PINC & 1) == 0);
+
+	TEST_END();
+}
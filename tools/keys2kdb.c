@@ -0,0 +1,169 @@
+/*
+ * keys2kdb.c
+ *
+ * Created: 17.10.2026 17:02:14
+ *
+ *    keys.kdb  keys.csv   (   keydb.h).
+ *   : gcc -o keys2kdb keys2kdb.c
+ * : keys2kdb keys.csv keys.kdb
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYDB_HEADER_SIZE 16
+#define KEYDB_RECORD_SIZE 12
+#define KEYDB_LOCATION_SIZE 32
+#define KEYDB_MAX 65534
+
+struct record
+{
+	uint8_t code[8];
+	uint8_t type;
+	uint16_t location;
+	char text[KEYDB_LOCATION_SIZE];
+};
+
+static const struct{const char* name; uint8_t type;} types[] = {	// enum_key  main.c
+	{"", 1}, {"", 2}, {"-01", 3}, {"", 4}, {"", 7}
+};
+
+static struct record* records;
+static char (*locations)[KEYDB_LOCATION_SIZE];
+static uint16_t* order;
+static size_t count, location_count;
+
+static int cmp_code(const void* a, const void* b)
+{
+	return memcmp(((const struct record*)a)->code, ((const struct record*)b)->code, 8);
+}
+
+static int cmp_text(const void* a, const void* b)
+{
+	return memcmp(a, b, KEYDB_LOCATION_SIZE);
+}
+
+static int cmp_location(const void* a, const void* b)
+{
+	const struct record* ra = &records[*(const uint16_t*)a];
+	const struct record* rb = &records[*(const uint16_t*)b];
+	if(ra->location != rb->location) return ra->location < rb->location ? -1 : 1;
+	return memcmp(ra->code, rb->code, 8);
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+static int parse_line(char* line, struct record* r)			//   file_read()
+{
+	size_t i = 0;
+	uint8_t byte = 0, nibble = 0, data = 0;
+
+	memset(r, 0, sizeof(*r));
+	for(;line[i];i++){
+		uint8_t temp = line[i];
+		if(temp == ' ' || temp == ';' || nibble == 2){
+			nibble = 0;
+			r->code[7-byte] = data;
+			byte++;
+			data = 0;
+			if(temp == ';' || byte > 7) break;
+			continue;
+		}
+		if(nibble++ == 1) data <<= 4;
+		if(temp <= '9') data |= temp - '0';
+		else if(temp <= 'F') data |= temp - 'A' + 10;
+		else if(temp <= 'f') data |= temp - 'a' + 10;
+	}
+	if(line[i] != ';') return 0;
+	i++;
+	for(size_t t=0;t<sizeof(types)/sizeof(types[0]);t++){
+		size_t len = strlen(types[t].name);
+		if(strncmp(&line[i], types[t].name, len) == 0 && line[i+len] == ';') r->type = types[t].type;
+	}
+	if(r->type == 0) return 0;
+	while(line[i] && line[i] != ';') i++;
+	if(line[i] == ';') i++;
+	strncpy(r->text, &line[i], KEYDB_LOCATION_SIZE-1);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	char line[256];
+	size_t capacity = 0;
+
+	if(argc != 3){
+		fprintf(stderr, "usage: keys2kdb keys.csv keys.kdb\n");
+		return 1;
+	}
+	FILE* in = fopen(argv[1], "rb");
+	if(!in){
+		perror(argv[1]);
+		return 1;
+	}
+	while(fgets(line, sizeof(line), in)){
+		line[strcspn(line, "\r\n")] = 0;
+		if(count == capacity){
+			capacity = capacity ? capacity * 2 : 64;
+			records = realloc(records, capacity * sizeof(*records));
+		}
+		if(parse_line(line, &records[count])) count++;
+		else if(line[0]) fprintf(stderr, "skipped: %s\n", line);
+		if(count > KEYDB_MAX){
+			fprintf(stderr, "too many keys\n");
+			return 1;
+		}
+	}
+	fclose(in);
+
+	qsort(records, count, sizeof(*records), cmp_code);
+
+	locations = calloc(count ? count : 1, KEYDB_LOCATION_SIZE);	//  ,  
+	for(size_t n=0;n<count;n++) memcpy(locations[n], records[n].text, KEYDB_LOCATION_SIZE);
+	qsort(locations, count, KEYDB_LOCATION_SIZE, cmp_text);
+	for(size_t n=0;n<count;n++){
+		if(location_count == 0 || memcmp(locations[location_count-1], locations[n], KEYDB_LOCATION_SIZE))
+			memmove(locations[location_count++], locations[n], KEYDB_LOCATION_SIZE);
+	}
+	for(size_t n=0;n<count;n++){
+		char (*found)[KEYDB_LOCATION_SIZE] = bsearch(records[n].text, locations, location_count, KEYDB_LOCATION_SIZE, cmp_text);
+		records[n].location = found - locations;
+	}
+
+	order = malloc((count ? count : 1) * sizeof(*order));
+	for(size_t n=0;n<count;n++) order[n] = n;
+	qsort(order, count, sizeof(*order), cmp_location);
+
+	FILE* out = fopen(argv[2], "wb");
+	if(!out){
+		perror(argv[2]);
+		return 1;
+	}
+	uint8_t buf[KEYDB_HEADER_SIZE] = {'K', 'D', 'B', '1'};
+	put16(buf+4, count);
+	put16(buf+6, location_count);
+	fwrite(buf, 1, KEYDB_HEADER_SIZE, out);
+	for(size_t n=0;n<count;n++){
+		memset(buf, 0, KEYDB_RECORD_SIZE);
+		memcpy(buf, records[n].code, 8);
+		buf[8] = records[n].type;
+		put16(buf+10, records[n].location);
+		fwrite(buf, 1, KEYDB_RECORD_SIZE, out);
+	}
+	for(size_t n=0;n<count;n++){
+		put16(buf, order[n]);
+		fwrite(buf, 1, 2, out);
+	}
+	fwrite(locations, KEYDB_LOCATION_SIZE, location_count, out);
+	if(fclose(out)){
+		perror(argv[2]);
+		return 1;
+	}
+	printf("%u keys, %u addresses\n", (unsigned)count, (unsigned)location_count);
+	return 0;
+}
\ No newline at end of file
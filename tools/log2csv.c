@@ -0,0 +1,67 @@
+/*
+ * log2csv.c
+ *
+ * Created: 17.10.2026 18:40:26
+ *
+ *    log.bin (   journal.h)  log.csv.
+ *   : gcc -o log2csv log2csv.c
+ * : log2csv log.bin log.csv
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#define JOURNAL_RECORD_SIZE 16
+#define JOURNAL_MARK 0xA5
+
+static const char* types[] = {	// enum_key  main.c
+	0, "", "", "-01", "", 0, 0, ""
+};
+
+static uint8_t crc8(const uint8_t* data, uint8_t len)	//CRC Dallas,  ds_crc()
+{
+	uint8_t crc = 0;
+	
+	while(len--){
+		crc ^= *data++;
+		for(uint8_t i=0;i<8;i++) crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : crc >> 1;
+	}
+	return crc;
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t buf[JOURNAL_RECORD_SIZE];
+	unsigned long n = 0, bad = 0;
+
+	if(argc != 3){
+		fprintf(stderr, "usage: log2csv log.bin log.csv\n");
+		return 1;
+	}
+	FILE* in = fopen(argv[1], "rb");
+	if(!in){
+		perror(argv[1]);
+		return 1;
+	}
+	FILE* out = fopen(argv[2], "wb");
+	if(!out){
+		perror(argv[2]);
+		return 1;
+	}
+	while(fread(buf, 1, sizeof(buf), in) == sizeof(buf)){
+		if(buf[0] != JOURNAL_MARK || crc8(buf, JOURNAL_RECORD_SIZE-1) != buf[JOURNAL_RECORD_SIZE-1]
+		|| buf[1] >= sizeof(types)/sizeof(types[0]) || !types[buf[1]]){
+			bad++;
+			continue;
+		}
+		unsigned count = buf[10] | buf[11] << 8;		//0     
+		for(uint8_t i=0;i<8;i++) fprintf(out, i ? " %02X" : "%02X", buf[2+7-i]);
+		fprintf(out, ";%s;%lu;%u;\r\n", types[buf[1]], n++, count ? count : 1);
+	}
+	fclose(in);
+	if(fclose(out)){
+		perror(argv[2]);
+		return 1;
+	}
+	printf("%lu records, %lu skipped\n", n, bad);
+	return 0;
+}
\ No newline at end of file
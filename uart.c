@@ -7,11 +7,7 @@
  * published by the Free Software Foundation.
  */
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
-#include <avr/sfr_defs.h>
-#include <avr/sleep.h>
+#include "hal.h"
 
 #include "uart.h"
 
@@ -9,7 +9,7 @@
 #pragma once
 
 #include <stdint.h>
-#include <avr/pgmspace.h>
+#include "hal.h"
 
 #ifdef __cplusplus
 extern "C"